@@ -0,0 +1,415 @@
+#include "includes.h"
+
+#include "chess.h"
+#include "engine.h"
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+
+#ifdef _WIN32
+#include <io.h>
+#else
+#include <dirent.h>
+#endif
+
+
+//---------------------------------------------------------------------------------------
+// Micro benchmarks
+// The move validation functions of Game, measured on every position reached in the
+// saved games of the test directory. Each benchmark goes through all the positions once
+// per iteration, so the numbers can be compared between builds, not between benchmarks
+//
+// Usage: bench [--data directory with the .dat files] [Google Benchmark options]
+//---------------------------------------------------------------------------------------
+#ifndef BENCH_DATA_DIR
+#define BENCH_DATA_DIR "test"
+#endif
+
+// A path to be checked by isPathFree()
+struct Path
+{
+   int             iPosition;
+   Chess::Position from;
+   Chess::Position to;
+   int             iDirection;
+};
+
+// A legal move, to be played and taken back
+struct PositionMove
+{
+   int          iPosition;
+   Engine::Move move;
+};
+
+// Some of the functions measured print their findings, which goes nowhere
+class NullBuffer : public std::streambuf
+{
+protected:
+   int overflow( int iChar ) { return iChar; }
+};
+
+static std::vector<Game>         positions;
+static std::vector<string>       move_texts;
+static std::vector<Path>         paths;
+static std::vector<PositionMove> legal_moves;
+
+
+// -------------------------------------------------------------------
+// Loading the positions
+// -------------------------------------------------------------------
+static std::vector<string> listDataFiles(const string& directory)
+{
+   std::vector<string> files;
+
+#ifdef _WIN32
+   struct _finddata_t data;
+   intptr_t hFind = _findfirst((directory + "/*.dat").c_str(), &data);
+
+   if ( -1 != hFind )
+   {
+      do
+      {
+         files.push_back(directory + "/" + data.name);
+      } while ( 0 == _findnext(hFind, &data) );
+
+      _findclose(hFind);
+   }
+#else
+   DIR* pDir = opendir(directory.c_str());
+
+   if ( NULL != pDir )
+   {
+      struct dirent* pEntry;
+
+      while ( NULL != (pEntry = readdir(pDir)) )
+      {
+         string name = pEntry->d_name;
+
+         if ( name.size() > 4 && 0 == name.compare(name.size() - 4, 4, ".dat") )
+         {
+            files.push_back(directory + "/" + name);
+         }
+      }
+
+      closedir(pDir);
+   }
+#endif
+
+   // Always in the same order, so the runs can be compared
+   std::sort(files.begin(), files.end());
+
+   return files;
+}
+
+static string trim(const string& text)
+{
+   size_t first = text.find_first_not_of(" \t\r");
+
+   if ( string::npos == first )
+   {
+      return "";
+   }
+
+   return text.substr(first, text.find_last_not_of(" \t\r") - first + 1);
+}
+
+static void addPosition(Game& game, Engine* pReferee)
+{
+   int iPosition = (int) positions.size();
+   positions.push_back(game);
+
+   // The legal moves, for movePiece() and undoLastMove()
+   Engine::Move moves[Engine::MAX_MOVES];
+   int iNumMoves = pReferee->getLegalMoves(moves, Engine::MAX_MOVES);
+
+   for (int i = 0; i < iNumMoves; i++)
+   {
+      PositionMove position_move = { iPosition, moves[i] };
+      legal_moves.push_back(position_move);
+   }
+
+   // Every path a rook, bishop or queen of the player to move could take
+   static const int directions[8][3] = { {  0,  1, Chess::HORIZONTAL }, {  0, -1, Chess::HORIZONTAL },
+                                         {  1,  0, Chess::VERTICAL   }, { -1,  0, Chess::VERTICAL   },
+                                         {  1,  1, Chess::DIAGONAL   }, {  1, -1, Chess::DIAGONAL   },
+                                         { -1,  1, Chess::DIAGONAL   }, { -1, -1, Chess::DIAGONAL   } };
+
+   for (int iRow = 0; iRow < 8; iRow++)
+   {
+      for (int iColumn = 0; iColumn < 8; iColumn++)
+      {
+         char chPiece = game.getPieceAtPosition(iRow, iColumn);
+
+         if ( EMPTY_SQUARE == chPiece || game.getCurrentTurn() != Chess::getPieceColor(chPiece) )
+         {
+            continue;
+         }
+
+         for (int i = 0; i < 8; i++)
+         {
+            bool bStraight = ( Chess::DIAGONAL != directions[i][2] );
+
+            if ( ('R' == toupper(chPiece) && false == bStraight) ||
+                 ('B' == toupper(chPiece) && true  == bStraight) ||
+                 ('R' != toupper(chPiece) && 'B' != toupper(chPiece) && 'Q' != toupper(chPiece)) )
+            {
+               continue;
+            }
+
+            // Paths of two squares or more, so there is something in between to check
+            for (int iDistance = 2; iDistance < 8; iDistance++)
+            {
+               int iToRow    = iRow    + iDistance * directions[i][0];
+               int iToColumn = iColumn + iDistance * directions[i][1];
+
+               if ( iToRow < 0 || iToRow > 7 || iToColumn < 0 || iToColumn > 7 )
+               {
+                  break;
+               }
+
+               Path path = { iPosition, { iRow, iColumn }, { iToRow, iToColumn }, directions[i][2] };
+               paths.push_back(path);
+            }
+         }
+      }
+   }
+}
+
+static void loadPositions(const string& file_name, Engine* pReferee)
+{
+   // Same format as loadGame(). A game stops at the first move that is not legal
+   std::ifstream ifs(file_name);
+   string line;
+
+   Game game;
+   pReferee->setFen(Engine::START_FEN);
+   addPosition(game, pReferee);
+
+   while ( std::getline(ifs, line) )
+   {
+      if ( 0 == line.compare(0, 1, "[") )
+      {
+         continue;
+      }
+
+      size_t separator = line.find("|");
+      string loaded_move[2];
+
+      loaded_move[0] = trim(line.substr(0, separator));
+
+      if ( string::npos != separator )
+      {
+         loaded_move[1] = trim(line.substr(separator + 1));
+      }
+
+      for (int i = 0; i < 2 && loaded_move[i] != ""; i++)
+      {
+         Engine::Move move;
+
+         if ( loaded_move[i].size() < 5 || false == pReferee->findLegalMove(loaded_move[i], &move) )
+         {
+            return;
+         }
+
+         move_texts.push_back(loaded_move[i]);
+
+         Engine::applyMove(game, move);
+         pReferee->playMove(Engine::moveToUci(move));
+
+         addPosition(game, pReferee);
+      }
+   }
+}
+
+
+// -------------------------------------------------------------------
+// Benchmarks
+// -------------------------------------------------------------------
+static void BM_isUnderAttack(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t p = 0; p < positions.size(); p++)
+      {
+         for (int iRow = 0; iRow < 8; iRow++)
+         {
+            for (int iColumn = 0; iColumn < 8; iColumn++)
+            {
+               Chess::UnderAttack attack = positions[p].isUnderAttack(iRow, iColumn, positions[p].getCurrentTurn());
+               benchmark::DoNotOptimize(attack.iNumAttackers);
+            }
+         }
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * positions.size() * 64);
+}
+BENCHMARK(BM_isUnderAttack);
+
+static void BM_isReachable(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t p = 0; p < positions.size(); p++)
+      {
+         for (int iRow = 0; iRow < 8; iRow++)
+         {
+            for (int iColumn = 0; iColumn < 8; iColumn++)
+            {
+               bool bReachable = positions[p].isReachable(iRow, iColumn, positions[p].getCurrentTurn());
+               benchmark::DoNotOptimize(bReachable);
+            }
+         }
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * positions.size() * 64);
+}
+BENCHMARK(BM_isReachable);
+
+static void BM_isPathFree(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t i = 0; i < paths.size(); i++)
+      {
+         bool bFree = positions[paths[i].iPosition].isPathFree(paths[i].from, paths[i].to, paths[i].iDirection);
+         benchmark::DoNotOptimize(bFree);
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * paths.size());
+}
+BENCHMARK(BM_isPathFree);
+
+static void BM_findKing(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t p = 0; p < positions.size(); p++)
+      {
+         Chess::Position white_king = positions[p].findKing(Chess::WHITE_PIECE);
+         Chess::Position black_king = positions[p].findKing(Chess::BLACK_PIECE);
+         benchmark::DoNotOptimize(white_king);
+         benchmark::DoNotOptimize(black_king);
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * positions.size() * 2);
+}
+BENCHMARK(BM_findKing);
+
+static void BM_isCheckMate(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t p = 0; p < positions.size(); p++)
+      {
+         bool bCheckMate = positions[p].isCheckMate();
+         benchmark::DoNotOptimize(bCheckMate);
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * positions.size());
+}
+BENCHMARK(BM_isCheckMate);
+
+static void BM_movePiece_undoLastMove(benchmark::State& state)
+{
+   for (auto _ : state)
+   {
+      for (size_t i = 0; i < legal_moves.size(); i++)
+      {
+         // undoLastMove() puts the position back exactly as it was, castling rights included
+         Game& game = positions[legal_moves[i].iPosition];
+
+         Engine::applyMove(game, legal_moves[i].move);
+         game.undoLastMove();
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * legal_moves.size());
+}
+BENCHMARK(BM_movePiece_undoLastMove);
+
+static void BM_parseMove(benchmark::State& state)
+{
+   Game game;
+
+   for (auto _ : state)
+   {
+      for (size_t i = 0; i < move_texts.size(); i++)
+      {
+         Chess::Position from;
+         Chess::Position to;
+         char chPromoted;
+
+         game.parseMove(move_texts[i], &from, &to, &chPromoted);
+         benchmark::DoNotOptimize(from);
+         benchmark::DoNotOptimize(to);
+         benchmark::DoNotOptimize(chPromoted);
+      }
+   }
+
+   state.SetItemsProcessed(state.iterations() * move_texts.size());
+}
+BENCHMARK(BM_parseMove);
+
+
+int main(int argc, char* argv[])
+{
+   string directory = BENCH_DATA_DIR;
+
+   // Our own options go first, the rest are for Google Benchmark
+   if ( argc > 2 && 0 == strcmp(argv[1], "--data") )
+   {
+      directory = argv[2];
+      argv[2]   = argv[0];
+      argv     += 2;
+      argc     -= 2;
+   }
+
+   benchmark::Initialize(&argc, argv);
+
+   if ( benchmark::ReportUnrecognizedArguments(argc, argv) )
+   {
+      return 1;
+   }
+
+   std::vector<string> files = listDataFiles(directory);
+
+   Engine* pReferee = new Engine();
+   pReferee->setHashSize(1);
+
+   for (size_t i = 0; i < files.size(); i++)
+   {
+      loadPositions(files[i], pReferee);
+   }
+
+   delete pReferee;
+
+   if ( positions.empty() )
+   {
+      cout << "No games found in " << directory << "\n";
+      return 1;
+   }
+
+   cout << files.size() << " games, " << positions.size() << " positions, " << legal_moves.size() << " moves, " << paths.size() << " paths\n";
+
+   // The report goes to the real output, cout is silenced while the benchmarks run
+   std::ostream report(cout.rdbuf());
+   NullBuffer   null_buffer;
+
+   benchmark::ConsoleReporter reporter(benchmark::ConsoleReporter::OO_Tabular);
+   reporter.SetOutputStream(&report);
+   reporter.SetErrorStream(&report);
+
+   std::streambuf* pSaved = cout.rdbuf(&null_buffer);
+   benchmark::RunSpecifiedBenchmarks(&reporter);
+   cout.rdbuf(pSaved);
+
+   benchmark::Shutdown();
+
+   return 0;
+}
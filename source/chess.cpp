@@ -1,11 +1,47 @@
 #include "includes.h"
 #include "chess.h"
-#include "user_interface.h"
+#include "counters.h"
 
 
+// -------------------------------------------------------------------
+// Explanations
+// Why a move is not valid, e.g. "Horizontal path to the right is not clear!".
+// The console shows them, a program embedding the rules usually does not want them
+// -------------------------------------------------------------------
+static std::ostream* pExplanations = nullptr;
+
+void Chess::setExplanations(std::ostream* pStream)
+{
+   pExplanations = pStream;
+}
+
+void Chess::explain(const string& text)
+{
+   if ( nullptr != pExplanations )
+   {
+      *pExplanations << text;
+   }
+}
+
 // -------------------------------------------------------------------
 // Chess class
 // -------------------------------------------------------------------
+const char Chess::initial_board[8][8] =
+{
+   // This represents the pieces on the board.
+   // Keep in mind that pieces[0][0] represents A1
+   // pieces[1][1] represents B2 and so on.
+   // Letters in CAPITAL are white
+   { 'R',  'N',  'B',  'Q',  'K',  'B',  'N',  'R' },
+   { 'P',  'P',  'P',  'P',  'P',  'P',  'P',  'P' },
+   { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
+   { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
+   { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
+   { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
+   { 'p',  'p',  'p',  'p',  'p',  'p',  'p',  'p' },
+   { 'r',  'n',  'b',  'q',  'k',  'b',  'n',  'r' },
+};
+
 int Chess::getPieceColor(char chPiece)
 {
    if (isupper(chPiece))
@@ -98,10 +134,14 @@ Game::Game()
    // Nothing has happend yet
    m_undo.bCapturedLastMove         = false;
    m_undo.bCanUndo                  = false;
-   m_undo.bCastlingKingSideAllowed  = false;
-   m_undo.bCastlingQueenSideAllowed = false;
-   m_undo.en_passant.bApplied       = false;
-   m_undo.castling.bApplied         = false;
+   m_undo.iEnPassantCaptured        = -1;
+   m_undo.iRookBefore               = -1;
+   m_undo.iRookAfter                = -1;
+   m_undo.chPromotedPawn            = EMPTY_SQUARE;
+
+   // Nothing captured
+   m_iNumCaptured[WHITE_PIECE] = 0;
+   m_iNumCaptured[BLACK_PIECE] = 0;
 
    // Initial board settings
    memcpy(board, initial_board, sizeof(char) * 8 * 8);
@@ -112,13 +152,15 @@ Game::Game()
 
    m_bCastlingQueenSideAllowed[WHITE_PLAYER] = true;
    m_bCastlingQueenSideAllowed[BLACK_PLAYER] = true;
+
+   // No pawn has moved yet
+   m_iEnPassantTarget = -1;
+   m_undo.iEnPassantTarget = -1;
 }
 
 Game::~Game()
 {
-   white_captured.clear();
-   black_captured.clear();
-   rounds.clear();
+   m_history.clear();
 }
 
 void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion)
@@ -129,54 +171,40 @@ void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPa
    // Is the destination square occupied?
    char chCapturedPiece = getPieceAtPosition(future);
 
+   // Everything about the position that the move can change, in case it is undone
+   memcpy(m_undo.bCastlingKingSideAllowed,  m_bCastlingKingSideAllowed,  sizeof(m_bCastlingKingSideAllowed));
+   memcpy(m_undo.bCastlingQueenSideAllowed, m_bCastlingQueenSideAllowed, sizeof(m_bCastlingQueenSideAllowed));
+   m_undo.iEnPassantTarget = m_iEnPassantTarget;
+
    // So, was a piece captured in this move?
    if (0x20 != chCapturedPiece)
    {
-      if (WHITE_PIECE == getPieceColor(chCapturedPiece))
-      {
-         // A white piece was captured
-         white_captured.push_back(chCapturedPiece);
-      }
-      else
-      {
-         // A black piece was captured
-         black_captured.push_back(chCapturedPiece);
-      }
+      int iColor = getPieceColor(chCapturedPiece);
+
+      m_chCaptured[iColor][m_iNumCaptured[iColor]++] = chCapturedPiece;
 
       // Set Undo structure. If a piece was captured, then no "en passant" move performed
-      m_undo.bCapturedLastMove = true;
-      
-      // Reset m_undo.castling
-      memset( &m_undo.en_passant, 0, sizeof( Chess::EnPassant ));
+      m_undo.bCapturedLastMove  = true;
+      m_undo.iEnPassantCaptured = -1;
    }
    else if (true == S_enPassant->bApplied)
    {
       char chCapturedEP = getPieceAtPosition(S_enPassant->PawnCaptured.iRow, S_enPassant->PawnCaptured.iColumn);
+      int  iColor       = getPieceColor(chCapturedEP);
 
-      if (WHITE_PIECE == getPieceColor(chCapturedEP))
-      {
-         // A white piece was captured
-         white_captured.push_back(chCapturedEP);
-      }
-      else
-      {
-         // A black piece was captured
-         black_captured.push_back(chCapturedEP);
-      }
+      m_chCaptured[iColor][m_iNumCaptured[iColor]++] = chCapturedEP;
 
       // Now, remove the captured pawn
       board[S_enPassant->PawnCaptured.iRow][S_enPassant->PawnCaptured.iColumn] = EMPTY_SQUARE;
 
       // Set Undo structure as piece was captured and "en passant" move was performed
-      m_undo.bCapturedLastMove = true;
-      memcpy(&m_undo.en_passant, S_enPassant, sizeof(Chess::EnPassant));
+      m_undo.bCapturedLastMove  = true;
+      m_undo.iEnPassantCaptured = (signed char) (S_enPassant->PawnCaptured.iRow * 8 + S_enPassant->PawnCaptured.iColumn);
    }
    else
    {
-      m_undo.bCapturedLastMove   = false;
-      
-      // Reset m_undo.castling
-      memset( &m_undo.en_passant, 0, sizeof( Chess::EnPassant ));
+      m_undo.bCapturedLastMove  = false;
+      m_undo.iEnPassantCaptured = -1;
    }
 
    // Remove piece from present position
@@ -188,14 +216,13 @@ void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPa
       board[future.iRow][future.iColumn] = S_promotion->chAfter;
 
       // Set Undo structure as a promotion occured
-      memcpy(&m_undo.promotion, S_promotion, sizeof(Chess::Promotion));
+      m_undo.chPromotedPawn = S_promotion->chBefore;
    }
    else
    {
       board[future.iRow][future.iColumn] = chPiece;
 
-      // Reset m_undo.promotion
-      memset( &m_undo.promotion, 0, sizeof( Chess::Promotion ));
+      m_undo.chPromotedPawn = EMPTY_SQUARE;
    }  
 
    // Was it a castling move?
@@ -211,16 +238,13 @@ void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPa
       board[S_castling->rook_after.iRow][S_castling->rook_after.iColumn] = chPiece;
 
       // Write this information to the m_undo struct
-      memcpy(&m_undo.castling, S_castling, sizeof(Chess::Castling));
-
-      // Save the 'CastlingAllowed' information in case the move is undone
-      m_undo.bCastlingKingSideAllowed  = m_bCastlingKingSideAllowed[getCurrentTurn()] ;
-      m_undo.bCastlingQueenSideAllowed = m_bCastlingQueenSideAllowed[getCurrentTurn()];
+      m_undo.iRookBefore = (signed char) (S_castling->rook_before.iRow * 8 + S_castling->rook_before.iColumn);
+      m_undo.iRookAfter  = (signed char) (S_castling->rook_after.iRow  * 8 + S_castling->rook_after.iColumn);
    }
    else
    {
-      // Reset m_undo.castling
-      memset( &m_undo.castling, 0, sizeof( Chess::Castling ));
+      m_undo.iRookBefore = -1;
+      m_undo.iRookAfter  = -1;
    }
 
    // Castling requirements
@@ -245,6 +269,30 @@ void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPa
       }
    }
 
+   // A rook captured on its first square can't castle anymore
+   if ( 'R' == toupper(chCapturedPiece) && ( (0 == future.iRow && WHITE_PIECE == getPieceColor(chCapturedPiece)) ||
+                                             (7 == future.iRow && BLACK_PIECE == getPieceColor(chCapturedPiece)) ) )
+   {
+      if ( 0 == future.iColumn )
+      {
+         m_bCastlingQueenSideAllowed[getPieceColor(chCapturedPiece)] = false;
+      }
+      else if ( 7 == future.iColumn )
+      {
+         m_bCastlingKingSideAllowed[getPieceColor(chCapturedPiece)] = false;
+      }
+   }
+
+   // After a pawn moves two squares, the opponent can capture it "en passant" on the square it jumped over
+   if ( 'P' == toupper(chPiece) && 2 == abs(future.iRow - present.iRow) )
+   {
+      m_iEnPassantTarget = (signed char) (((present.iRow + future.iRow) / 2) * 8 + present.iColumn);
+   }
+   else
+   {
+      m_iEnPassantTarget = -1;
+   }
+
    // Change turns
    changeTurns();
 
@@ -254,21 +302,22 @@ void Game::movePiece(Position present, Position future, Chess::EnPassant* S_enPa
 
 void Game::undoLastMove()
 {
-   string last_move = getLastMove();
-
-   // Parse the line
    Chess::Position from;
    Chess::Position to;
-   parseMove(last_move, &from, &to);
+
+   if ( false == getLastMove(&from, &to) )
+   {
+      return;
+   }
 
    // Since we want to undo a move, we will be moving the piece from (iToRow, iToColumn) to (iFromRow, iFromColumn)
    char chPiece = getPieceAtPosition(to.iRow, to.iColumn);
 
    // Moving it back
    // If there was a castling
-   if ( true == m_undo.promotion.bApplied )
+   if ( EMPTY_SQUARE != m_undo.chPromotedPawn )
    {
-      board[from.iRow][from.iColumn] = m_undo.promotion.chBefore;
+      board[from.iRow][from.iColumn] = m_undo.chPromotedPawn;
    }
    else
    {
@@ -284,23 +333,16 @@ void Game::undoLastMove()
       // Let's retrieve the last captured piece
       char chCaptured;
 
-      // Since we already changed turns back, it means we should we pop a piece from the oponents vector
-      if (WHITE_PLAYER == m_CurrentTurn)
-      {
-         chCaptured = black_captured.back();
-         black_captured.pop_back();
-      }
-      else
-      {
-         chCaptured = white_captured.back();
-         white_captured.pop_back();
-      }
+      // Since we already changed turns back, it means we should we pop a piece from the oponents list
+      int iColor = getOpponentColor();
+
+      chCaptured = m_chCaptured[iColor][--m_iNumCaptured[iColor]];
 
       // Move the captured piece back. Was this an "en passant" move?
-      if (m_undo.en_passant.bApplied)
+      if ( -1 != m_undo.iEnPassantCaptured )
       {
          // Move the captured piece back
-         board[m_undo.en_passant.PawnCaptured.iRow][m_undo.en_passant.PawnCaptured.iColumn] = chCaptured;
+         board[m_undo.iEnPassantCaptured / 8][m_undo.iEnPassantCaptured % 8] = chCaptured;
 
          // Remove the attacker
          board[to.iRow][to.iColumn] = EMPTY_SQUARE;
@@ -316,27 +358,29 @@ void Game::undoLastMove()
    }
 
    // If there was a castling
-   if ( m_undo.castling.bApplied )
+   if ( -1 != m_undo.iRookBefore )
    {
-      char chRook = getPieceAtPosition(m_undo.castling.rook_after.iRow, m_undo.castling.rook_after.iColumn);
+      char chRook = board[m_undo.iRookAfter / 8][m_undo.iRookAfter % 8];
 
       // Remove the rook from present position
-      board[m_undo.castling.rook_after.iRow][m_undo.castling.rook_after.iColumn] = EMPTY_SQUARE;
+      board[m_undo.iRookAfter / 8][m_undo.iRookAfter % 8] = EMPTY_SQUARE;
 
       // 'Jump' into to new position
-      board[m_undo.castling.rook_before.iRow][m_undo.castling.rook_before.iColumn] = chRook;
-
-      // Restore the values of castling allowed or not
-      m_bCastlingKingSideAllowed[getCurrentTurn()]  = m_undo.bCastlingKingSideAllowed;
-      m_bCastlingQueenSideAllowed[getCurrentTurn()] = m_undo.bCastlingQueenSideAllowed;
+      board[m_undo.iRookBefore / 8][m_undo.iRookBefore % 8] = chRook;
    }
 
+   // Restore the values of castling allowed or not, and the "en passant" square
+   memcpy(m_bCastlingKingSideAllowed,  m_undo.bCastlingKingSideAllowed,  sizeof(m_bCastlingKingSideAllowed));
+   memcpy(m_bCastlingQueenSideAllowed, m_undo.bCastlingQueenSideAllowed, sizeof(m_bCastlingQueenSideAllowed));
+   m_iEnPassantTarget = m_undo.iEnPassantTarget;
+
    // Clean m_undo struct
    m_undo.bCanUndo             = false;
    m_undo.bCapturedLastMove    = false;
-   m_undo.en_passant.bApplied  = false;
-   m_undo.castling.bApplied    = false;
-   m_undo.promotion.bApplied   = false;
+   m_undo.iEnPassantCaptured   = -1;
+   m_undo.iRookBefore          = -1;
+   m_undo.iRookAfter           = -1;
+   m_undo.chPromotedPawn       = EMPTY_SQUARE;
 
    // If it was a checkmate, toggle back to game not finished
    m_bGameFinished = false;
@@ -362,6 +406,114 @@ bool Game::castlingAllowed(Side iSide, int iColor)
    }
 }
 
+void Game::setCastlingAllowed(Side iSide, int iColor, bool bAllowed)
+{
+   if ( QUEEN_SIDE == iSide )
+   {
+      m_bCastlingQueenSideAllowed[iColor] = bAllowed;
+   }
+   else //if ( KING_SIDE == iSide )
+   {
+      m_bCastlingKingSideAllowed[iColor] = bAllowed;
+   }
+}
+
+bool Game::getEnPassantTarget(Position* pTarget)
+{
+   if ( -1 == m_iEnPassantTarget )
+   {
+      pTarget->iRow    = -1;
+      pTarget->iColumn = -1;
+
+      return false;
+   }
+
+   pTarget->iRow    = m_iEnPassantTarget / 8;
+   pTarget->iColumn = m_iEnPassantTarget % 8;
+
+   return true;
+}
+
+void Game::setEnPassantTarget(Position target)
+{
+   m_iEnPassantTarget = ( -1 == target.iRow ) ? -1 : (signed char) (target.iRow * 8 + target.iColumn);
+}
+
+string Game::getFen(void)
+{
+   string fen;
+
+   for (int i = 7; i >= 0; i--)
+   {
+      int iEmpty = 0;
+
+      for (int j = 0; j < 8; j++)
+      {
+         char chPiece = getPieceAtPosition(i, j);
+
+         if ( EMPTY_SQUARE == chPiece )
+         {
+            iEmpty++;
+            continue;
+         }
+
+         if ( iEmpty > 0 )
+         {
+            fen += char('0' + iEmpty);
+            iEmpty = 0;
+         }
+
+         fen += chPiece;
+      }
+
+      if ( iEmpty > 0 )
+      {
+         fen += char('0' + iEmpty);
+      }
+
+      if ( i > 0 )
+      {
+         fen += '/';
+      }
+   }
+
+   fen += (WHITE_PLAYER == getCurrentTurn()) ? " w " : " b ";
+
+   string castling;
+
+   if ( castlingAllowed(KING_SIDE,  WHITE_PIECE) ) castling += 'K';
+   if ( castlingAllowed(QUEEN_SIDE, WHITE_PIECE) ) castling += 'Q';
+   if ( castlingAllowed(KING_SIDE,  BLACK_PIECE) ) castling += 'k';
+   if ( castlingAllowed(QUEEN_SIDE, BLACK_PIECE) ) castling += 'q';
+
+   fen += castling.empty() ? "-" : castling;
+
+   if ( -1 != m_iEnPassantTarget )
+   {
+      fen += ' ';
+      fen += char('a' + m_iEnPassantTarget % 8);
+      fen += char('1' + m_iEnPassantTarget / 8);
+   }
+   else
+   {
+      fen += " -";
+   }
+
+   fen += " 0 1";
+
+   return fen;
+}
+
+int Game::getNumCaptured(int iColor)
+{
+   return m_iNumCaptured[iColor];
+}
+
+char Game::getCaptured(int iColor, int iIndex)
+{
+   return m_chCaptured[iColor][iIndex];
+}
+
 char Game::getPieceAtPosition(int iRow, int iColumn)
 {
    return board[iRow][iColumn];
@@ -372,8 +524,15 @@ char Game::getPieceAtPosition(Position pos)
    return board[pos.iRow][pos.iColumn];
 }
 
+void Game::setPieceAtPosition(int iRow, int iColumn, char chPiece)
+{
+   board[iRow][iColumn] = chPiece;
+}
+
 char Game::getPiece_considerMove(int iRow, int iColumn, IntendedMove* intended_move)
 {
+   COUNT_CALL(COUNTER_GET_PIECE_CONSIDER_MOVE);
+
    char chPiece;
 
    // If there is no intended move, just return the current position of the board
@@ -406,6 +565,8 @@ char Game::getPiece_considerMove(int iRow, int iColumn, IntendedMove* intended_m
 
 Chess::UnderAttack Game::isUnderAttack(int iRow, int iColumn, int iColor, IntendedMove* pintended_move)
 {
+   COUNT_CALL(COUNTER_IS_UNDER_ATTACK);
+
    UnderAttack attack = { 0 };
 
    // a) Direction: HORIZONTAL
@@ -601,7 +762,7 @@ Chess::UnderAttack Game::isUnderAttack(int iRow, int iColumn, int iColor, Intend
       }
 
       // Check the diagonal up-left
-      for (int i = iRow + 1, j = iColumn - 1; i < 8 && j > 0; i++, j--)
+      for (int i = iRow + 1, j = iColumn - 1; i < 8 && j >= 0; i++, j--)
       {
          char chPieceFound = getPiece_considerMove(i, j, pintended_move);
          if (EMPTY_SQUARE == chPieceFound)
@@ -649,7 +810,7 @@ Chess::UnderAttack Game::isUnderAttack(int iRow, int iColumn, int iColor, Intend
       }
 
       // Check the diagonal down-right
-      for (int i = iRow - 1, j = iColumn + 1; i > 0 && j < 8; i--, j++)
+      for (int i = iRow - 1, j = iColumn + 1; i >= 0 && j < 8; i--, j++)
       {
          char chPieceFound = getPiece_considerMove(i, j, pintended_move);
          if (EMPTY_SQUARE == chPieceFound)
@@ -697,7 +858,7 @@ Chess::UnderAttack Game::isUnderAttack(int iRow, int iColumn, int iColor, Intend
       }
 
       // Check the diagonal down-left
-      for (int i = iRow - 1, j = iColumn - 1; i > 0 && j > 0; i--, j--)
+      for (int i = iRow - 1, j = iColumn - 1; i >= 0 && j >= 0; i--, j--)
       {
          char chPieceFound = getPiece_considerMove(i, j, pintended_move);
          if (EMPTY_SQUARE == chPieceFound)
@@ -963,7 +1124,7 @@ bool Game::isReachable( int iRow, int iColumn, int iColor )
       }
 
       // Check the diagonal up-left
-      for (int i = iRow + 1, j = iColumn - 1; i < 8 && j > 0; i++, j--)
+      for (int i = iRow + 1, j = iColumn - 1; i < 8 && j >= 0; i++, j--)
       {
          char chPieceFound = getPieceAtPosition(i, j);
          if (EMPTY_SQUARE == chPieceFound)
@@ -992,7 +1153,7 @@ bool Game::isReachable( int iRow, int iColumn, int iColor )
       }
 
       // Check the diagonal down-right
-      for (int i = iRow - 1, j = iColumn + 1; i > 0 && j < 8; i--, j++)
+      for (int i = iRow - 1, j = iColumn + 1; i >= 0 && j < 8; i--, j++)
       {
          char chPieceFound = getPieceAtPosition(i, j);
          if (EMPTY_SQUARE == chPieceFound)
@@ -1021,7 +1182,7 @@ bool Game::isReachable( int iRow, int iColumn, int iColor )
       }
 
       // Check the diagonal down-left
-      for (int i = iRow - 1, j = iColumn - 1; i > 0 && j > 0; i--, j--)
+      for (int i = iRow - 1, j = iColumn - 1; i >= 0 && j >= 0; i--, j--)
       {
          char chPieceFound = getPieceAtPosition(i, j);
          if (EMPTY_SQUARE == chPieceFound)
@@ -1114,7 +1275,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
          // If the piece wants to move from column 0 to column 7, we must check if columns 1-6 are free
          if (startingPos.iColumn == finishingPos.iColumn)
          {
-            cout << "Error. Movement is horizontal but column is the same\n";
+            explain("Error. Movement is horizontal but column is the same\n");
          }
 
          // Moving to the right
@@ -1128,7 +1289,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow, i))
                {
                   bFree = false;
-                  cout << "Horizontal path to the right is not clear!\n";
+                  explain("Horizontal path to the right is not clear!\n");
                }
             }
          }
@@ -1144,7 +1305,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow, i))
                {
                   bFree = false;
-                  cout << "Horizontal path to the left is not clear!\n";
+                  explain("Horizontal path to the left is not clear!\n");
                }
             }
          }
@@ -1157,7 +1318,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
          // If the piece wants to move from column 0 to column 7, we must check if columns 1-6 are free
          if (startingPos.iRow == finishingPos.iRow)
          {
-            cout << "Error. Movement is vertical but row is the same\n";
+            explain("Error. Movement is vertical but row is the same\n");
            throw("Error. Movement is vertical but row is the same");
          }
 
@@ -1172,7 +1333,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if ( isSquareOccupied(i, startingPos.iColumn) )
                {
                   bFree = false;
-                  cout << "Vertical path up is not clear!\n";
+                  explain("Vertical path up is not clear!\n");
                }
             }
          }
@@ -1188,7 +1349,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if ( isSquareOccupied(i, startingPos.iColumn) )
                {
                   bFree = false;
-                  cout << "Vertical path down is not clear!\n";
+                  explain("Vertical path down is not clear!\n");
                }
             }
          }
@@ -1208,7 +1369,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow + i, startingPos.iColumn + i))
                {
                   bFree = false;
-                  cout << "Diagonal path up-right is not clear!\n";
+                  explain("Diagonal path up-right is not clear!\n");
                }
             }
          }
@@ -1224,7 +1385,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow+i, startingPos.iColumn-i))
                {
                   bFree = false;
-                  cout << "Diagonal path up-left is not clear!\n";
+                  explain("Diagonal path up-left is not clear!\n");
                }
             }
          }
@@ -1240,7 +1401,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow - i, startingPos.iColumn + i))
                {
                   bFree = false;
-                  cout << "Diagonal path down-right is not clear!\n";
+                  explain("Diagonal path down-right is not clear!\n");
                }
             }
          }
@@ -1256,7 +1417,7 @@ bool Game::isPathFree(Position startingPos, Position finishingPos, int iDirectio
                if (isSquareOccupied(startingPos.iRow - i, startingPos.iColumn - i))
                {
                   bFree = false;
-                  cout << "Diagonal path down-left is not clear!\n";
+                  explain("Diagonal path down-left is not clear!\n");
                }
             }
          }
@@ -1286,7 +1447,7 @@ bool Game::canBeBlocked(Position startingPos, Position finishingPos, int iDirect
          // If the piece wants to move from column 0 to column 7, we must check if columns 1-6 are free
          if (startingPos.iColumn == finishingPos.iColumn)
          {
-            cout << "Error. Movement is horizontal but column is the same\n";
+            explain("Error. Movement is horizontal but column is the same\n");
          }
 
          // Moving to the right
@@ -1323,7 +1484,7 @@ bool Game::canBeBlocked(Position startingPos, Position finishingPos, int iDirect
          // If the piece wants to move from column 0 to column 7, we must check if columns 1-6 are free
          if (startingPos.iRow == finishingPos.iRow)
          {
-            cout << "Error. Movement is vertical but row is the same\n";
+            explain("Error. Movement is vertical but row is the same\n");
            throw("Error. Movement is vertical but row is the same");
          }
 
@@ -1411,7 +1572,7 @@ bool Game::canBeBlocked(Position startingPos, Position finishingPos, int iDirect
 
          else
          {
-            cout << "Error. Diagonal move not allowed\n";
+            explain("Error. Diagonal move not allowed\n");
             throw("Error. Diagonal move not allowed");
          }
       }
@@ -1423,6 +1584,8 @@ bool Game::canBeBlocked(Position startingPos, Position finishingPos, int iDirect
 
 bool Game::isCheckMate()
 {
+   COUNT_CALL(COUNTER_IS_CHECKMATE);
+
    bool bCheckmate = false;
 
    // 1. First of all, it the king in check?
@@ -1462,8 +1625,8 @@ bool Game::isCheckMate()
       intended_move.to.iColumn   = iColumnToTest;
 
       // Now, for every possible move of the king, check if it would be in jeopardy
-      // Since the move has already been made, current_game->getCurrentTurn() now will return 
-      // the next player's color. And it is in fact this king that we want to check for jeopardy
+      // Since the move has already been made, it is now the other player's turn in this game,
+      // and it is in fact that player's king that we want to check for jeopardy
       Chess::UnderAttack king_moved = isUnderAttack( iRowToTest, iColumnToTest, getCurrentTurn(), &intended_move );
 
       if ( false == king_moved.bUnderAttack )
@@ -1657,6 +1820,381 @@ int Game::getOpponentColor(void)
    return iColor;
 }
 
+bool Game::isMoveValid(Position present, Position future, EnPassant* S_enPassant, Castling* S_castling, Promotion* S_promotion)
+{
+   bool bValid = false;
+
+   char chPiece = getPieceAtPosition(present.iRow, present.iColumn);
+
+   // ----------------------------------------------------
+   // 1. Is the piece  allowed to move in that direction?
+   // ----------------------------------------------------
+   switch( toupper(chPiece) )
+   {
+      case 'P':
+      {
+         // Wants to move forward
+         if ( future.iColumn == present.iColumn )
+         {
+            // Simple move forward
+            if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 1) ||
+                 (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 1) )
+            {
+               if ( EMPTY_SQUARE == getPieceAtPosition(future.iRow, future.iColumn) )
+               {
+                  bValid = true;
+               }
+            }
+
+            // Double move forward
+            else if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 2) ||
+                      (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 2) )
+            {
+               // This is only allowed if the pawn is in its original place
+               if ( Chess::isWhitePiece(chPiece) )
+               {
+                  if ( EMPTY_SQUARE == getPieceAtPosition(future.iRow-1, future.iColumn) &&
+                       EMPTY_SQUARE == getPieceAtPosition(future.iRow, future.iColumn)   &&
+                                1   == present.iRow )
+                  {
+                     bValid = true;
+                  }
+               }
+               else // if ( isBlackPiece(chPiece) )
+               {
+                  if ( EMPTY_SQUARE == getPieceAtPosition(future.iRow + 1, future.iColumn) &&
+                       EMPTY_SQUARE == getPieceAtPosition(future.iRow, future.iColumn)     &&
+                                6   == present.iRow)
+                  {
+                     bValid = true;
+                  }
+               }
+            }
+            else
+            {
+               // This is invalid
+               return false;
+            }
+         }
+         
+         // The "en passant" move (to an empty square, otherwise it is a normal capture)
+         else if ( EMPTY_SQUARE == getPieceAtPosition(future.iRow, future.iColumn) &&
+                   ( (Chess::isWhitePiece(chPiece) && 4 == present.iRow && 5 == future.iRow && 1 == abs(future.iColumn - present.iColumn) ) ||
+                     (Chess::isBlackPiece(chPiece) && 3 == present.iRow && 2 == future.iRow && 1 == abs(future.iColumn - present.iColumn) ) ) )
+         {
+            // It is only valid on the square the opponent's pawn jumped over in the last move
+            Chess::Position target;
+
+            if ( true == getEnPassantTarget(&target) && target.iRow == future.iRow && target.iColumn == future.iColumn )
+            {
+               explain("En passant move!\n");
+               bValid = true;
+
+               // The captured pawn is beside ours, on the column we move to
+               S_enPassant->bApplied = true;
+               S_enPassant->PawnCaptured.iRow    = present.iRow;
+               S_enPassant->PawnCaptured.iColumn = future.iColumn;
+            }
+         }
+
+         // Wants to capture a piece
+         else if (1 == abs(future.iColumn - present.iColumn))
+         {
+            if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 1) || (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 1))
+            {
+               // Only allowed if there is something to be captured in the square
+               if (EMPTY_SQUARE != getPieceAtPosition(future.iRow, future.iColumn))
+               {
+                  bValid = true;
+                  explain("Pawn captured a piece!\n");
+               }
+            }
+         }
+         else
+         {
+            // This is invalid
+            return false;
+         }
+
+         // If a pawn reaches its eight rank, it must be promoted to another piece
+         if ( (Chess::isWhitePiece( chPiece ) && 7 == future.iRow) ||
+              (Chess::isBlackPiece( chPiece ) && 0 == future.iRow) )
+         {
+            explain("Pawn must be promoted!\n");
+            S_promotion->bApplied = true;
+         }
+      }
+      break;
+
+      case 'R':
+      {
+         // Horizontal move
+         if ( (future.iRow == present.iRow) && (future.iColumn != present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::HORIZONTAL) )
+            {
+               bValid = true;
+            }
+         }
+         // Vertical move
+         else if ( (future.iRow != present.iRow) && (future.iColumn == present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::VERTICAL) )
+            {
+               bValid = true;
+            }
+         }
+      }
+      break;
+
+      case 'N':
+      {
+         if ( (2 == abs(future.iRow - present.iRow)) && (1 == abs(future.iColumn - present.iColumn)) )
+         {
+            bValid = true;
+         }
+
+         else if (( 1 == abs(future.iRow - present.iRow)) && (2 == abs(future.iColumn - present.iColumn)) )
+         {
+            bValid = true;
+         }
+      }
+      break;
+
+      case 'B':
+      {
+         // Diagonal move
+         if ( abs(future.iRow - present.iRow) == abs(future.iColumn - present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::DIAGONAL) )
+            {
+               bValid = true;
+            }
+         }
+      }
+      break;
+
+      case 'Q':
+      {
+         // Horizontal move
+         if ( (future.iRow == present.iRow) && (future.iColumn != present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::HORIZONTAL))
+            {
+               bValid = true;
+            }
+         }
+         // Vertical move
+         else if ( (future.iRow != present.iRow) && (future.iColumn == present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::VERTICAL))
+            {
+               bValid = true;
+            }
+         }
+
+         // Diagonal move
+         else if ( abs(future.iRow - present.iRow) == abs(future.iColumn - present.iColumn) )
+         {
+            // Check if there are no pieces on the way
+            if ( isPathFree(present, future, Chess::DIAGONAL))
+            {
+               bValid = true;
+            }
+         }
+      }
+      break;
+
+      case 'K':
+      {
+         // Horizontal move by 1
+         if ( (future.iRow == present.iRow) && (1 == abs(future.iColumn - present.iColumn) ) )
+         {
+            bValid = true;
+         }
+
+         // Vertical move by 1
+         else if ( (future.iColumn == present.iColumn) && (1 == abs(future.iRow - present.iRow) ) )
+         {
+            bValid = true;
+         }
+
+         // Diagonal move by 1
+         else if ( (1 == abs(future.iRow - present.iRow) ) && (1 == abs(future.iColumn - present.iColumn) ) )
+         {
+            bValid = true;
+         }
+
+         // Castling
+         else if ( (future.iRow == present.iRow) && (2 == abs(future.iColumn - present.iColumn) ) )
+         {
+            // Castling is only allowed in these circunstances:
+
+            // 1. King is not in check
+            if ( true == playerKingInCheck() )
+            {
+               return false;
+            }
+
+            // 2. No pieces in between the king and the rook
+            if ( false == isPathFree( present, future, Chess::HORIZONTAL ) )
+            {
+               return false;
+            }
+
+            // 3. King and rook must not have moved yet;
+            // 4. King must not pass through a square that is attacked by an enemy piece
+            if ( future.iColumn > present.iColumn )
+            {
+               // if future.iColumn is greather, it means king side
+               if ( false == castlingAllowed(Chess::Side::KING_SIDE, Chess::getPieceColor(chPiece) ) )
+               {
+                  explain("Castling to the king side is not allowed.\n");
+                  return false;
+               }
+               else
+               {
+                  // Check if the square that the king skips is not under attack
+                  Chess::UnderAttack square_skipped = isUnderAttack( present.iRow, present.iColumn + 1, getCurrentTurn() );
+                  if ( false == square_skipped.bUnderAttack )
+                  {
+                     // Fill the S_castling structure
+                     S_castling->bApplied = true;
+
+                     // Present position of the rook
+                     S_castling->rook_before.iRow    = present.iRow;
+                     S_castling->rook_before.iColumn = present.iColumn + 3;
+
+                     // Future position of the rook
+                     S_castling->rook_after.iRow    = future.iRow;
+                     S_castling->rook_after.iColumn = present.iColumn + 1; // future.iColumn -1
+
+                     bValid = true;
+                  }
+               }
+            }
+            else //if (future.iColumn < present.iColumn)
+            {
+               // if present.iColumn is greather, it means queen side
+               if (false == castlingAllowed(Chess::Side::QUEEN_SIDE, Chess::getPieceColor(chPiece)))
+               {
+                  explain("Castling to the queen side is not allowed.\n");
+                  return false;
+               }
+               else if ( EMPTY_SQUARE != getPieceAtPosition(present.iRow, present.iColumn - 3) )
+               {
+                  // isPathFree() only checked up to the king's destination, the rook passes one square further
+                  explain("Castling to the queen side is blocked.\n");
+                  return false;
+               }
+               else
+               {
+                  // Check if the square that the king skips is not attacked
+                  Chess::UnderAttack square_skipped = isUnderAttack( present.iRow, present.iColumn - 1, getCurrentTurn() );
+                  if ( false == square_skipped.bUnderAttack )
+                  {
+                     // Fill the S_castling structure
+                     S_castling->bApplied = true;
+
+                     // Present position of the rook
+                     S_castling->rook_before.iRow    = present.iRow;
+                     S_castling->rook_before.iColumn = present.iColumn - 4;
+
+                     // Future position of the rook
+                     S_castling->rook_after.iRow    = future.iRow;
+                     S_castling->rook_after.iColumn = present.iColumn - 1; // future.iColumn +1
+
+                     bValid = true;
+                  }
+               }
+            }
+         }
+      }
+      break;
+
+      default:
+      {
+         explain("!!!!Should not reach here. Invalid piece: " + string(1, chPiece) + "\n\n\n");
+      }
+      break;
+   }
+
+   // If it is a move in an invalid direction, do not even bother to check the rest
+   if ( false == bValid )
+   {
+      explain("Piece is not allowed to move to that square\n");
+      return false;
+   }
+
+
+   // -------------------------------------------------------------------------
+   // 2. Is there another piece of the same color on the destination square?
+   // -------------------------------------------------------------------------
+   if (isSquareOccupied(future.iRow, future.iColumn))
+   {
+      char chAuxPiece = getPieceAtPosition(future.iRow, future.iColumn);
+      if ( Chess::getPieceColor(chPiece) == Chess::getPieceColor(chAuxPiece) )
+      {
+         explain("Position is already taken by a piece of the same color\n");
+         return false;
+      }
+   }
+
+   // ----------------------------------------------
+   // 3. Would the king be in check after the move?
+   // ----------------------------------------------
+   if ( true == wouldKingBeInCheck(chPiece, present, future, S_enPassant) )
+   {
+      explain("Move would put player's king in check\n");
+      return false;
+   }
+
+   return bValid;
+}
+
+string Game::makeTheMove(Position present, Position future, EnPassant* S_enPassant, Castling* S_castling, Promotion* S_promotion)
+{
+   string description;
+
+   char chPiece = getPieceAtPosition(present.iRow, present.iColumn);
+
+   // -----------------------
+   // Captured a piece?
+   // -----------------------
+   if ( isSquareOccupied(future.iRow, future.iColumn) )
+   {
+      char chAuxPiece = getPieceAtPosition(future.iRow, future.iColumn);
+
+      if ( Chess::getPieceColor(chPiece) != Chess::getPieceColor(chAuxPiece))
+      {
+         description = Chess::describePiece(chAuxPiece) + " captured!\n";
+      }
+      else
+      {
+         explain("Error. We should not be making this move\n");
+         throw("Error. We should not be making this move");
+      }
+   }
+   else if (true == S_enPassant->bApplied)
+   {
+      description = "Pawn captured by \"en passant\" move!\n";
+   }
+
+   if ( (true == S_castling->bApplied) )
+   {
+      description = "Castling applied!\n";
+   }
+
+   movePiece(present, future, S_enPassant, S_castling, S_promotion);
+
+   return description;
+}
+
 void Game::parseMove(string move, Position* pFrom, Position* pTo, char* chPromoted)
 {
    pFrom->iColumn = move[0];
@@ -1685,71 +2223,112 @@ void Game::parseMove(string move, Position* pFrom, Position* pTo, char* chPromot
    }
 }
 
-void Game::logMove(std::string &to_record)
+// Promotions as stored in the history: 0 is no promotion
+static const char history_promotions[] = { EMPTY_SQUARE, 'N', 'B', 'R', 'Q' };
+
+void Game::logMove(Position from, Position to, char chPromoted)
 {
-   // If record contains only 5 chracters, add spaces
-   // Because when 
-   if ( to_record.length() == 5 )
+   MoveRecord record = (MoveRecord) ( (from.iRow * 8 + from.iColumn) | ((to.iRow * 8 + to.iColumn) << 6) );
+
+   for (int i = 1; i < 5; i++)
    {
-      to_record += "  ";
+      if ( toupper(chPromoted) == history_promotions[i] )
+      {
+         record |= (MoveRecord) (i << 12);
+      }
    }
 
-   if ( WHITE_PLAYER == getCurrentTurn() )
+   // Nothing is allocated until the first move, then rarely again
+   if ( 0 == m_history.capacity() )
    {
-      // If this was a white player move, create a new round and leave the black_move empty
-      Round round;
-      round.white_move = to_record;
-      round.black_move = "";
-
-      rounds.push_back(round);
+      m_history.reserve(HISTORY_FIRST_CHUNK);
    }
-   else
-   {
-      // If this was a black_move, just update the last Round
-      Round round = rounds[rounds.size() - 1];
-      round.black_move = to_record;
 
-      // Remove the last round and put it back, now with the black move
-      rounds.pop_back();
-      rounds.push_back(round);
-   }
+   m_history.push_back(record);
 }
 
-string Game::getLastMove(void)
+bool Game::getLastMove(Position* pFrom, Position* pTo, char* pchPromoted)
 {
-   string last_move;
-
-   // Who did the last move?
-   if (BLACK_PLAYER == getCurrentTurn())
+   if ( m_history.empty() )
    {
-      // If it's black's turn now, white had the last move
-      last_move = rounds[rounds.size() - 1].white_move;
+      return false;
    }
-   else
+
+   MoveRecord record = m_history.back();
+
+   pFrom->iRow    = (record & 0x3F) / 8;
+   pFrom->iColumn = (record & 0x3F) % 8;
+   pTo->iRow      = ((record >> 6) & 0x3F) / 8;
+   pTo->iColumn   = ((record >> 6) & 0x3F) % 8;
+
+   if ( nullptr != pchPromoted )
    {
-      // Last move was black's
-      last_move = rounds[rounds.size() - 1].black_move;
+      *pchPromoted = history_promotions[(record >> 12) & 0x07];
    }
 
-   return last_move;
+   return true;
 }
 
 void Game::deleteLastMove( void )
 {
-   // Notice we already changed turns back
-   if (WHITE_PLAYER == getCurrentTurn())
+   if ( false == m_history.empty() )
    {
-      // Last move was white's turn, so simply pop from the back
-      rounds.pop_back();
+      m_history.pop_back();
    }
-   else
+}
+
+int Game::getNumHalfMoves( void )
+{
+   return (int) m_history.size();
+}
+
+int Game::getNumRounds( void )
+{
+   return (int) (m_history.size() + 1) / 2;
+}
+
+string Game::getMoveText( int iHalfMove )
+{
+   MoveRecord record = m_history[iHalfMove];
+
+   int iFrom = record & 0x3F;
+   int iTo   = (record >> 6) & 0x3F;
+
+   // e.g. "E2-E4"
+   string text;
+
+   text += char('A' + iFrom % 8);
+   text += char('1' + iFrom / 8);
+   text += '-';
+   text += char('A' + iTo % 8);
+   text += char('1' + iTo / 8);
+
+   if ( 0 != ((record >> 12) & 0x07) )
+   {
+      text += '=';
+      text += history_promotions[(record >> 12) & 0x07];
+   }
+
+   return text;
+}
+
+string Game::getRoundText( int iRound )
+{
+   // Moves with only 5 characters get two spaces, so the columns line up with the promotions
+   string white_move = getMoveText(iRound * 2);
+   string black_move;
+
+   if ( iRound * 2 + 1 < (int) m_history.size() )
    {
-      // Last move was black's, so let's 
-      Round round = rounds[rounds.size() - 1];
-      round.black_move = "";
+      black_move = getMoveText(iRound * 2 + 1);
+   }
+
+   white_move.resize(7, ' ');
 
-      // Pop last round and put it back, now without the black move
-      rounds.pop_back();
-      rounds.push_back(round);
+   if ( false == black_move.empty() )
+   {
+      black_move.resize(7, ' ');
    }
-}
\ No newline at end of file
+
+   return white_move + " | " + black_move;
+}
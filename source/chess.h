@@ -1,5 +1,8 @@
 #pragma once
 #include "includes.h"
+#include "pool.h"
+
+#define EMPTY_SQUARE 0x20
 
 class Chess
 {
@@ -12,6 +15,11 @@ public:
 
    static std::string describePiece( char chPiece );
 
+   // Where the rules explain why a move is not valid. NULL (the default) for no explanations
+   static void setExplanations( std::ostream* pStream );
+
+   static void explain( const string& text );
+
    enum PieceColor
    {
       WHITE_PIECE = 0,
@@ -85,21 +93,8 @@ public:
       Attacker attacker[9]; //maximum theorical number of attackers
    };
 
-   const char initial_board[8][8] =
-   {
-      // This represents the pieces on the board.
-      // Keep in mind that pieces[0][0] represents A1
-      // pieces[1][1] represents B2 and so on.
-      // Letters in CAPITAL are white
-      { 'R',  'N',  'B',  'Q',  'K',  'B',  'N',  'R' },
-      { 'P',  'P',  'P',  'P',  'P',  'P',  'P',  'P' },
-      { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
-      { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
-      { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
-      { 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20, 0x20 },
-      { 'p',  'p',  'p',  'p',  'p',  'p',  'p',  'p' },
-      { 'r',  'n',  'b',  'q',  'k',  'b',  'n',  'r' },
-   };
+   // The pieces before the first move, shared by all the games (see chess.cpp)
+   static const char initial_board[8][8];
 };
 
 class Game : Chess
@@ -108,8 +103,20 @@ public:
    Game();
    ~Game();
 
+   // From the pool of the thread, see pool.h
+   static void* operator new( size_t iSize ) { return poolAllocate(iSize); }
+   static void  operator delete( void* p ) { poolFree(p); }
+
    void movePiece( Position present, Position future, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion );
 
+   // Checks a move of the player to move against the rules, and fills what movePiece() needs
+   // to know about it (en passant, castling, promotion). The position is not changed
+   bool isMoveValid( Position present, Position future, EnPassant* S_enPassant, Castling* S_castling, Promotion* S_promotion );
+
+   // movePiece(), returning what happened for the player: "Black pawn captured!\n",
+   // "Castling applied!\n"... or an empty string for a simple move
+   string makeTheMove( Position present, Position future, EnPassant* S_enPassant, Castling* S_castling, Promotion* S_promotion );
+
    void undoLastMove();
 
    bool undoIsPossible();
@@ -120,6 +127,19 @@ public:
 
    char getPieceAtPosition( Position pos );
 
+   void setPieceAtPosition( int iRow, int iColumn, char chPiece );
+
+   void setCastlingAllowed( Side iSide, int iColor, bool bAllowed );
+
+   // The square the last pawn that moved two squares jumped over. Returns false if there is none
+   bool getEnPassantTarget( Position* pTarget );
+
+   // For positions that did not come from a game, e.g. a FEN. iRow is -1 if there is none
+   void setEnPassantTarget( Position target );
+
+   // The position as a FEN. Move counters are not kept, they are always "0 1"
+   string getFen( void );
+
    char getPiece_considerMove( int iRow, int iColumn, IntendedMove* intended_move = nullptr );
 
    UnderAttack isUnderAttack( int iRow, int iColumn, int iColor, IntendedMove* pintended_move = nullptr );
@@ -152,25 +172,30 @@ public:
 
    void parseMove( string move, Position* pFrom, Position* pTo, char* chPromoted = nullptr );
 
-   void logMove( std::string &to_record );
+   // Must be called before movePiece(), chPromoted is EMPTY_SQUARE if it is not a promotion
+   void logMove( Position from, Position to, char chPromoted );
 
-   string getLastMove( void );
+   // Returns false if no move was made yet
+   bool getLastMove( Position* pFrom, Position* pTo, char* pchPromoted = nullptr );
 
    void deleteLastMove( void );
 
-   // Save all the moves
-   struct Round
-   {
-      string white_move;
-      string black_move;
-   };
+   // Moves made so far, counting white's and black's apart
+   int getNumHalfMoves( void );
+
+   // One white move and the black move that followed, if there was one
+   int getNumRounds( void );
+
+   // Text of one move, e.g. "E2-E4" or "E7-E8=Q". Only built when it is shown or saved
+   string getMoveText( int iHalfMove );
 
-   //std::deque<std::string> moves;
-   std::deque<Round> rounds;
+   // "E2-E4   | E7-E5  ", as shown by printSituation() and written by saveGame()
+   string getRoundText( int iRound );
 
-   // Save the captured pieces
-   std::vector<char> white_captured;
-   std::vector<char> black_captured;
+   // The pieces of iColor captured so far, in the order they were captured
+   int getNumCaptured( int iColor );
+
+   char getCaptured( int iColor, int iIndex );
 
 private:
 
@@ -183,20 +208,45 @@ private:
       bool bCanUndo;
       bool bCapturedLastMove;
 
-      bool bCastlingKingSideAllowed;
-      bool bCastlingQueenSideAllowed;
+      // Before the move, for both colors
+      bool bCastlingKingSideAllowed[2];
+      bool bCastlingQueenSideAllowed[2];
+
+      // Squares are iRow * 8 + iColumn, -1 for none
+      signed char iEnPassantTarget;   // Before the move
+      signed char iEnPassantCaptured; // The pawn captured "en passant"
+      signed char iRookBefore;        // Where the rook was and went, if it was a castling
+      signed char iRookAfter;
 
-      EnPassant en_passant;
-      Castling  castling;
-      Promotion promotion;
+      // The pawn that was promoted, EMPTY_SQUARE if it was not a promotion
+      char chPromotedPawn;
    } m_undo;
 
    // Castling requirements
    bool m_bCastlingKingSideAllowed[2];
    bool m_bCastlingQueenSideAllowed[2];
 
+   // Square a pawn can move to capturing "en passant" (iRow * 8 + iColumn), -1 if none
+   signed char m_iEnPassantTarget;
+
+   // The captured pieces of each color. Never more than 15: pieces are not created during
+   // a game, a promotion changes one that is already there
+   char          m_chCaptured[2][16];
+   unsigned char m_iNumCaptured[2];
+
+   // All the moves, 16 bits each: from square (6 bits), to square (6 bits) and
+   // the promotion (3 bits, see packPromotion()). Squares are iRow * 8 + iColumn
+   typedef unsigned short MoveRecord;
+
+   enum
+   {
+      HISTORY_FIRST_CHUNK = 128 // Half moves, reserved by the first move: an idle game has no history at all
+   };
+
+   std::vector<MoveRecord, PoolAllocator<MoveRecord> > m_history;
+
    // Holds the current turn
-   int  m_CurrentTurn;
+   char m_CurrentTurn;
 
    // Has the game finished already?
    bool m_bGameFinished;
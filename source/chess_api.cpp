@@ -0,0 +1,265 @@
+#include "includes.h"
+#include "chess.h"
+#include "chess_api.h"
+
+#include <new>
+
+
+//---------------------------------------------------------------------------------------
+// C API
+// See chess_api.h. No exception goes through these functions: the caller may not be C++
+//---------------------------------------------------------------------------------------
+struct chess_game
+{
+   Game game;
+
+   // From the pool of the thread if it has one (the server), otherwise the heap
+   static void* operator new( size_t iSize ) { return poolAllocate(iSize); }
+   static void  operator delete( void* p ) { poolFree(p); }
+};
+
+// -------------------------------------------------------------------
+// Helpers
+// -------------------------------------------------------------------
+static bool parseSquare(const char* pText, Chess::Position* pSquare)
+{
+   char chColumn = (char) tolower(pText[0]);
+
+   if ( chColumn < 'a' || chColumn > 'h' || pText[1] < '1' || pText[1] > '8' )
+   {
+      return false;
+   }
+
+   pSquare->iColumn = chColumn - 'a';
+   pSquare->iRow    = pText[1] - '1';
+
+   return true;
+}
+
+static bool parseMoveText(const char* pText, Chess::Position* pFrom, Chess::Position* pTo, char* pchPromotion)
+{
+   // "e2e4", "e7e8q", "E2-E4" or "E7-E8=Q"
+   if ( NULL == pText || false == parseSquare(pText, pFrom) )
+   {
+      return false;
+   }
+
+   pText += ( '-' == pText[2] ) ? 3 : 2;
+
+   if ( false == parseSquare(pText, pTo) )
+   {
+      return false;
+   }
+
+   pText += ( '=' == pText[2] ) ? 3 : 2;
+
+   *pchPromotion = (char) tolower(pText[0]);
+
+   if ( 0 == *pchPromotion )
+   {
+      return true;
+   }
+
+   if ( 'q' != *pchPromotion && 'r' != *pchPromotion && 'b' != *pchPromotion && 'n' != *pchPromotion )
+   {
+      return false;
+   }
+
+   return ( 0 == pText[1] );
+}
+
+static bool isLegal(Game& game, Chess::Position from, Chess::Position to, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion)
+{
+   // isMoveValid() expects a piece of the player to move, going somewhere else
+   char chPiece = game.getPieceAtPosition(from);
+
+   if ( EMPTY_SQUARE == chPiece || game.getCurrentTurn() != Chess::getPieceColor(chPiece) )
+   {
+      return false;
+   }
+
+   if ( from.iRow == to.iRow && from.iColumn == to.iColumn )
+   {
+      return false;
+   }
+
+   return game.isMoveValid(from, to, S_enPassant, S_castling, S_promotion);
+}
+
+static void fillMove(chess_move* pMove, Chess::Position from, Chess::Position to, char chPromotion)
+{
+   pMove->from      = (unsigned char) (from.iRow * 8 + from.iColumn);
+   pMove->to        = (unsigned char) (to.iRow   * 8 + to.iColumn);
+   pMove->promotion = chPromotion;
+
+   pMove->text[0] = (char) ('a' + from.iColumn);
+   pMove->text[1] = (char) ('1' + from.iRow);
+   pMove->text[2] = (char) ('a' + to.iColumn);
+   pMove->text[3] = (char) ('1' + to.iRow);
+   pMove->text[4] = chPromotion;
+   pMove->text[5] = 0;
+}
+
+static int findLegalMoves(Game& game, chess_move* pMoves, int iMaxMoves, int iStopAt)
+{
+   // Every square a piece of the player to move could go to, through the same rules as the
+   // console. Stops as soon as iStopAt moves are found (to know whether there is any)
+   static const char promotions[] = { 'q', 'r', 'b', 'n' };
+
+   int iCount = 0;
+
+   for (int iSquare = 0; iSquare < 64 && iCount < iStopAt; iSquare++)
+   {
+      Chess::Position from = { iSquare / 8, iSquare % 8 };
+      char chPiece = game.getPieceAtPosition(from);
+
+      if ( EMPTY_SQUARE == chPiece || game.getCurrentTurn() != Chess::getPieceColor(chPiece) )
+      {
+         continue;
+      }
+
+      for (int iTarget = 0; iTarget < 64 && iCount < iStopAt; iTarget++)
+      {
+         Chess::Position to = { iTarget / 8, iTarget % 8 };
+         char chTarget = game.getPieceAtPosition(to);
+
+         if ( iTarget == iSquare || (EMPTY_SQUARE != chTarget && Chess::getPieceColor(chTarget) == Chess::getPieceColor(chPiece)) )
+         {
+            continue;
+         }
+
+         Chess::EnPassant S_enPassant = { 0 };
+         Chess::Castling  S_castling  = { 0 };
+         Chess::Promotion S_promotion = { 0 };
+
+         if ( false == game.isMoveValid(from, to, &S_enPassant, &S_castling, &S_promotion) )
+         {
+            continue;
+         }
+
+         // A promotion is four moves, one for each piece
+         int iVariants = ( true == S_promotion.bApplied ) ? 4 : 1;
+
+         for (int i = 0; i < iVariants; i++)
+         {
+            if ( iCount < iMaxMoves )
+            {
+               fillMove(&pMoves[iCount], from, to, ( true == S_promotion.bApplied ) ? promotions[i] : 0);
+            }
+
+            iCount++;
+         }
+      }
+   }
+
+   return iCount;
+}
+
+// -------------------------------------------------------------------
+// Functions
+// -------------------------------------------------------------------
+int chess_api_version(void)
+{
+   return CHESS_API_VERSION;
+}
+
+chess_game* chess_new(void)
+{
+   try
+   {
+      return new chess_game;
+   }
+   catch (...)
+   {
+      return NULL;
+   }
+}
+
+void chess_free(chess_game* game)
+{
+   delete game;
+}
+
+int chess_apply_move(chess_game* game, const char* move)
+{
+   Chess::Position from;
+   Chess::Position to;
+   char            chPromotion;
+
+   if ( NULL == game || false == parseMoveText(move, &from, &to, &chPromotion) )
+   {
+      return CHESS_INVALID_TEXT;
+   }
+
+   try
+   {
+      Chess::EnPassant S_enPassant = { 0 };
+      Chess::Castling  S_castling  = { 0 };
+      Chess::Promotion S_promotion = { 0 };
+
+      if ( false == isLegal(game->game, from, to, &S_enPassant, &S_castling, &S_promotion) )
+      {
+         return CHESS_ILLEGAL_MOVE;
+      }
+
+      // The piece is only given, and must be given, for a promotion
+      if ( S_promotion.bApplied != (0 != chPromotion) )
+      {
+         return CHESS_ILLEGAL_MOVE;
+      }
+
+      if ( true == S_promotion.bApplied )
+      {
+         S_promotion.chBefore = game->game.getPieceAtPosition(from);
+         S_promotion.chAfter  = (char) ( (Chess::WHITE_PLAYER == game->game.getCurrentTurn()) ? toupper(chPromotion) : chPromotion );
+      }
+
+      game->game.logMove(from, to, (true == S_promotion.bApplied) ? S_promotion.chAfter : EMPTY_SQUARE);
+      game->game.movePiece(from, to, &S_enPassant, &S_castling, &S_promotion);
+   }
+   catch (...)
+   {
+      return CHESS_ILLEGAL_MOVE;
+   }
+
+   return CHESS_OK;
+}
+
+int chess_legal_moves(chess_game* game, chess_move* moves, int max_moves)
+{
+   if ( NULL == game || (NULL == moves && max_moves > 0) )
+   {
+      return 0;
+   }
+
+   try
+   {
+      return findLegalMoves(game->game, moves, max_moves, CHESS_MAX_MOVES);
+   }
+   catch (...)
+   {
+      return 0;
+   }
+}
+
+int chess_status(chess_game* game)
+{
+   if ( NULL == game )
+   {
+      return CHESS_PLAYING;
+   }
+
+   try
+   {
+      if ( true == game->game.playerKingInCheck() )
+      {
+         return ( true == game->game.isCheckMate() ) ? CHESS_CHECKMATE : CHESS_CHECK;
+      }
+
+      return ( 0 == findLegalMoves(game->game, NULL, 0, 1) ) ? CHESS_STALEMATE : CHESS_PLAYING;
+   }
+   catch (...)
+   {
+      return CHESS_PLAYING;
+   }
+}
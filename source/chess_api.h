@@ -0,0 +1,74 @@
+#pragma once
+
+//---------------------------------------------------------------------------------------
+// C API
+// The rules of libchess for programs written in other languages (through ctypes, cgo...).
+// A game is an opaque handle, and everything returned goes into buffers given by the
+// caller. A game only allocates to hold its moves: on the first move, then when it grows
+// longer than 128, 256, 512... half moves.
+//
+// Moves are written as in UCI, "e2e4" or "e7e8q". "E2-E4" and "E7-E8=Q", as in the
+// saved games, are accepted too. Squares are numbered row * 8 + column: A1 is 0, H1 is 7
+// and H8 is 63.
+//
+// A handle must not be used by two threads at the same time, different handles can.
+//---------------------------------------------------------------------------------------
+#if defined(_WIN32) && defined(CHESS_API_EXPORTS)
+#define CHESS_API __declspec(dllexport)
+#elif defined(__GNUC__)
+#define CHESS_API __attribute__((visibility("default")))
+#else
+#define CHESS_API
+#endif
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Changes only if a function or a structure of this file changes
+#define CHESS_API_VERSION 1
+
+// More than any position can have, enough for chess_legal_moves()
+#define CHESS_MAX_MOVES 256
+
+// Returned by chess_apply_move()
+#define CHESS_OK               0
+#define CHESS_ILLEGAL_MOVE    -1 // Not a legal move in this position, nothing was changed
+#define CHESS_INVALID_TEXT    -2 // Not written as a move
+
+// Returned by chess_status()
+#define CHESS_PLAYING          0
+#define CHESS_CHECK            1 // The player to move is in check
+#define CHESS_CHECKMATE        2
+#define CHESS_STALEMATE        3
+
+typedef struct chess_game chess_game;
+
+typedef struct chess_move
+{
+   unsigned char from;
+   unsigned char to;
+   char          promotion; // 'q', 'r', 'b', 'n', or 0 if it is not a promotion
+   char          text[6];   // The same move in UCI, e.g. "e7e8q", ending with a 0
+} chess_move;
+
+CHESS_API int chess_api_version( void );
+
+// A game in the initial position, white to move. NULL if there is no memory
+CHESS_API chess_game* chess_new( void );
+
+CHESS_API void chess_free( chess_game* game );
+
+// Plays the move for the player to move, CHESS_OK or one of the errors above
+CHESS_API int chess_apply_move( chess_game* game, const char* move );
+
+// Fills moves with the legal moves of the player to move, up to max_moves of them.
+// Returns how many there are (which can be more than max_moves, see CHESS_MAX_MOVES)
+CHESS_API int chess_legal_moves( chess_game* game, chess_move* moves, int max_moves );
+
+// CHESS_PLAYING, CHESS_CHECK, CHESS_CHECKMATE or CHESS_STALEMATE
+CHESS_API int chess_status( chess_game* game );
+
+#ifdef __cplusplus
+}
+#endif
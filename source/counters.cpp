@@ -0,0 +1,118 @@
+#include "counters.h"
+
+#ifdef CHESS_COUNTERS
+
+#include <mutex>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <x86intrin.h>
+#endif
+
+
+//---------------------------------------------------------------------------------------
+// Counters
+//---------------------------------------------------------------------------------------
+static const char* counter_names[NUM_COUNTERS] =
+{
+   "isUnderAttack",
+   "getPiece_considerMove",
+   "isCheckMate",
+   "generateMoves",
+   "evaluate",
+};
+
+struct CounterValues
+{
+   unsigned long long iCalls[NUM_COUNTERS];
+   unsigned long long iCycles[NUM_COUNTERS];
+};
+
+// What all the threads that already ended have counted. Printed when the program exits
+class CounterTotals
+{
+public:
+   CounterTotals()
+   {
+      memset(&m_values, 0, sizeof(m_values));
+   }
+
+   ~CounterTotals()
+   {
+      printReport();
+   }
+
+   void merge( const CounterValues& values )
+   {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (int i = 0; i < NUM_COUNTERS; i++)
+      {
+         m_values.iCalls[i]  += values.iCalls[i];
+         m_values.iCycles[i] += values.iCycles[i];
+      }
+   }
+
+private:
+   void printReport( void )
+   {
+      cerr << "\n" << left << setw(24) << "Counter" << right << setw(16) << "Calls" << setw(18) << "Cycles" << setw(14) << "Cycles/call" << "\n";
+
+      for (int i = 0; i < NUM_COUNTERS; i++)
+      {
+         unsigned long long iPerCall = ( 0 == m_values.iCalls[i] ) ? 0 : m_values.iCycles[i] / m_values.iCalls[i];
+
+         cerr << left << setw(24) << counter_names[i] << right << setw(16) << m_values.iCalls[i] << setw(18) << m_values.iCycles[i] << setw(14) << iPerCall << "\n";
+      }
+   }
+
+   std::mutex    m_mutex;
+   CounterValues m_values;
+};
+
+// Constructed before any thread starts counting, so it is destroyed after the
+// counters of the main thread have been merged
+static CounterTotals& getTotals( void )
+{
+   static CounterTotals totals;
+   return totals;
+}
+
+// The counters of one thread, merged into the totals when the thread ends
+class ThreadCounters
+{
+public:
+   ThreadCounters()
+   {
+      memset(&m_values, 0, sizeof(m_values));
+      getTotals();
+   }
+
+   ~ThreadCounters()
+   {
+      getTotals().merge(m_values);
+   }
+
+   CounterValues m_values;
+};
+
+static thread_local ThreadCounters thread_counters;
+
+unsigned long long readCycles(void)
+{
+#if defined(_MSC_VER) || defined(__i386__) || defined(__x86_64__)
+   return __rdtsc();
+#else
+   // No cycle counter, nanoseconds will have to do
+   return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+}
+
+void addToCounter(Counter counter, unsigned long long iCycles)
+{
+   thread_counters.m_values.iCalls[counter]++;
+   thread_counters.m_values.iCycles[counter] += iCycles;
+}
+
+#endif
@@ -0,0 +1,49 @@
+#pragma once
+#include "includes.h"
+
+//---------------------------------------------------------------------------------------
+// Counters
+// How many times the hot functions are called and how many cycles they take, to see
+// where the time goes without a profiler. Only compiled in with CHESS_COUNTERS defined:
+// otherwise COUNT_CALL() expands to nothing and none of this exists in the build.
+//
+// Each thread counts on its own and adds to the totals when it ends. The report is
+// printed to stderr when the program exits. Cycles include the functions called, so
+// isCheckMate() also pays for the isUnderAttack() calls it makes
+//---------------------------------------------------------------------------------------
+#ifdef CHESS_COUNTERS
+
+enum Counter
+{
+   COUNTER_IS_UNDER_ATTACK = 0,
+   COUNTER_GET_PIECE_CONSIDER_MOVE,
+   COUNTER_IS_CHECKMATE,
+   COUNTER_GENERATE_MOVES,
+   COUNTER_EVALUATE,
+   NUM_COUNTERS
+};
+
+unsigned long long readCycles( void );
+
+// Adds to the counters of the current thread
+void addToCounter( Counter counter, unsigned long long iCycles );
+
+// Counts the call and the cycles between construction and destruction
+class ScopedCounter
+{
+public:
+   explicit ScopedCounter( Counter counter ) : m_counter(counter), m_iStart(readCycles()) {}
+   ~ScopedCounter() { addToCounter(m_counter, readCycles() - m_iStart); }
+
+private:
+   Counter            m_counter;
+   unsigned long long m_iStart;
+};
+
+#define COUNT_CALL(counter) ScopedCounter scoped_counter(counter)
+
+#else
+
+#define COUNT_CALL(counter)
+
+#endif
@@ -0,0 +1,2239 @@
+#include "includes.h"
+#include <sstream>
+#include <thread>
+#include "engine.h"
+#include "counters.h"
+
+
+// -------------------------------------------------------------------
+// Tables
+// -------------------------------------------------------------------
+
+// Indexed by getPieceIndex(): pawn, knight, bishop, rook, queen, king
+static const int piece_value[6] = { 100, 320, 330, 500, 900, 0 };
+
+// Values used by the static exchange evaluation: the king can never be traded
+static const int see_value[6] = { 100, 320, 330, 500, 900, 20000 };
+
+// How close a square is to the center of the board
+static const int center_distance[8][8] =
+{
+   { 0, 1, 2, 3, 3, 2, 1, 0 },
+   { 1, 2, 3, 4, 4, 3, 2, 1 },
+   { 2, 3, 4, 5, 5, 4, 3, 2 },
+   { 3, 4, 5, 6, 6, 5, 4, 3 },
+   { 3, 4, 5, 6, 6, 5, 4, 3 },
+   { 2, 3, 4, 5, 5, 4, 3, 2 },
+   { 1, 2, 3, 4, 4, 3, 2, 1 },
+   { 0, 1, 2, 3, 3, 2, 1, 0 },
+};
+
+static const Chess::Position knight_offsets[8] = { {  1, -2 }, {  2, -1 }, {  2, 1 }, {  1, 2 },
+                                                   { -1, -2 }, { -2, -1 }, { -2, 1 }, { -1, 2 } };
+
+static const Chess::Position king_offsets[8]   = { {  1, -1 }, {  1, 0 }, {  1,  1 }, { 0,  1 },
+                                                   { -1,  1 }, { -1, 0 }, { -1, -1 }, { 0, -1 } };
+
+// The first 4 directions are straight (rook), the last 4 are diagonal (bishop)
+static const Chess::Position slide_directions[8] = { {  1, 0 }, { -1, 0 }, { 0,  1 }, {  0, -1 },
+                                                     {  1, 1 }, {  1, -1 }, { -1, 1 }, { -1, -1 } };
+
+
+// -------------------------------------------------------------------
+// Zobrist keys
+// One random number for each piece on each square, the side to move,
+// the castling rights and the column of the "en passant" square
+// -------------------------------------------------------------------
+struct ZobristKeys
+{
+   unsigned long long piece[12][64];
+   unsigned long long side;
+   unsigned long long castling[16];
+   unsigned long long en_passant[8];
+
+   ZobristKeys()
+   {
+      // Fixed seed, so the keys are the same on every run
+      unsigned long long iSeed = 0x9E3779B97F4A7C15ULL;
+
+      for (int i = 0; i < 12; i++)
+      {
+         for (int j = 0; j < 64; j++)
+         {
+            piece[i][j] = next(&iSeed);
+         }
+      }
+
+      side = next(&iSeed);
+
+      for (int i = 0; i < 16; i++)
+      {
+         castling[i] = next(&iSeed);
+      }
+
+      for (int i = 0; i < 8; i++)
+      {
+         en_passant[i] = next(&iSeed);
+      }
+   }
+
+   static unsigned long long next(unsigned long long* pSeed)
+   {
+      // xorshift64*
+      *pSeed ^= *pSeed >> 12;
+      *pSeed ^= *pSeed << 25;
+      *pSeed ^= *pSeed >> 27;
+      return *pSeed * 2685821657736338717ULL;
+   }
+};
+
+static const ZobristKeys zobrist;
+
+static int getZobristIndex(char chPiece)
+{
+   return Chess::getPieceColor(chPiece) * 6 + Engine::getPieceIndex(chPiece);
+}
+
+
+// -------------------------------------------------------------------
+// Engine class
+// -------------------------------------------------------------------
+Engine::Engine()
+{
+   m_EnPassant.iRow    = -1;
+   m_EnPassant.iColumn = -1;
+
+   initPosition();
+
+   m_iNodes        = 0;
+   m_iBestPvLength = 0;
+   m_iHashSize     = 16;
+
+   memset(&m_stats, 0, sizeof(SearchStats));
+
+   m_bUseNullMove  = true;
+   m_bUseLmr       = true;
+   m_bStopped      = false;
+   m_bPondering    = false;
+   m_pfnInfo       = NULL;
+
+   m_bStopRequested = false;
+   m_bPonderHit     = false;
+
+   memset(m_iPvLength, 0, sizeof(m_iPvLength));
+
+   memset(m_killers, 0, sizeof(m_killers));
+   memset(m_history, 0, sizeof(m_history));
+   memset(&m_rootBest, 0, sizeof(Move));
+   memset(&m_limits, 0, sizeof(Limits));
+}
+
+Engine::~Engine()
+{
+}
+
+void Engine::initPosition(void)
+{
+   // Everything that is derived from the pieces on the board
+   m_King[WHITE_PIECE] = m_position.findKing(WHITE_PIECE);
+   m_King[BLACK_PIECE] = m_position.findKing(BLACK_PIECE);
+
+   memset(m_iMaterial, 0, sizeof(m_iMaterial));
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         char chPiece = m_position.getPieceAtPosition(i, j);
+
+         if ( EMPTY_SQUARE != chPiece )
+         {
+            m_iMaterial[getPieceColor(chPiece)][getPieceIndex(chPiece)]++;
+         }
+      }
+   }
+
+   m_iHashKey = computeHashKey();
+   m_gameKeys.clear();
+
+   m_iPly = 0;
+}
+
+void Engine::setPosition(Game& game)
+{
+   // Copy the pieces
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         m_position.setPieceAtPosition(i, j, game.getPieceAtPosition(i, j));
+      }
+   }
+
+   // Whose turn is it?
+   if ( m_position.getCurrentTurn() != game.getCurrentTurn() )
+   {
+      m_position.changeTurns();
+   }
+
+   // Castling rights
+   for (int iColor = WHITE_PIECE; iColor <= BLACK_PIECE; iColor++)
+   {
+      m_position.setCastlingAllowed(KING_SIDE,  iColor, game.castlingAllowed(KING_SIDE,  iColor));
+      m_position.setCastlingAllowed(QUEEN_SIDE, iColor, game.castlingAllowed(QUEEN_SIDE, iColor));
+   }
+
+   // "En passant" is only possible if the last move was a double move forward by a pawn (iRow is -1 otherwise)
+   game.getEnPassantTarget(&m_EnPassant);
+
+   initPosition();
+}
+
+const char* const Engine::START_FEN = "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1";
+
+bool Engine::setFen(string fen)
+{
+   // Example: "rnbqkbnr/pppppppp/8/8/4P3/8/PPPP1PPP/RNBQKBNR b KQkq e3 0 1"
+   std::istringstream iss(fen);
+
+   string pieces;
+   string turn;
+   string castling;
+   string en_passant;
+
+   iss >> pieces >> turn >> castling >> en_passant;
+
+   if ( pieces.empty() || turn.empty() )
+   {
+      return false;
+   }
+
+   // 1. Pieces, starting from the 8th row
+   char board[8][8];
+   memset(board, EMPTY_SQUARE, sizeof(board));
+
+   int iRow    = 7;
+   int iColumn = 0;
+
+   for (unsigned i = 0; i < pieces.length(); i++)
+   {
+      char ch = pieces[i];
+
+      if ( '/' == ch )
+      {
+         iRow--;
+         iColumn = 0;
+      }
+      else if ( ch >= '1' && ch <= '8' )
+      {
+         iColumn += ch - '0';
+      }
+      else if ( NULL != strchr("PNBRQKpnbrqk", ch) && iRow >= 0 && iColumn < 8 )
+      {
+         board[iRow][iColumn++] = ch;
+      }
+      else
+      {
+         return false;
+      }
+   }
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         m_position.setPieceAtPosition(i, j, board[i][j]);
+      }
+   }
+
+   // 2. Side to move
+   int iTurn = ('b' == turn[0]) ? BLACK_PLAYER : WHITE_PLAYER;
+
+   if ( m_position.getCurrentTurn() != iTurn )
+   {
+      m_position.changeTurns();
+   }
+
+   // 3. Castling rights
+   m_position.setCastlingAllowed(KING_SIDE,  WHITE_PIECE, string::npos != castling.find('K'));
+   m_position.setCastlingAllowed(QUEEN_SIDE, WHITE_PIECE, string::npos != castling.find('Q'));
+   m_position.setCastlingAllowed(KING_SIDE,  BLACK_PIECE, string::npos != castling.find('k'));
+   m_position.setCastlingAllowed(QUEEN_SIDE, BLACK_PIECE, string::npos != castling.find('q'));
+
+   // 4. "En passant" square
+   m_EnPassant.iRow    = -1;
+   m_EnPassant.iColumn = -1;
+
+   if ( en_passant.length() == 2 && en_passant[0] >= 'a' && en_passant[0] <= 'h' && en_passant[1] >= '1' && en_passant[1] <= '8' )
+   {
+      m_EnPassant.iRow    = en_passant[1] - '1';
+      m_EnPassant.iColumn = en_passant[0] - 'a';
+   }
+
+   initPosition();
+
+   return true;
+}
+
+string Engine::getFen(void)
+{
+   // The search keeps its own "en passant" square, the one of m_position is not updated
+   Position saved;
+   m_position.getEnPassantTarget(&saved);
+   m_position.setEnPassantTarget(m_EnPassant);
+
+   string fen = m_position.getFen();
+
+   m_position.setEnPassantTarget(saved);
+
+   return fen;
+}
+
+bool Engine::playMove(string text)
+{
+   // Make the move for good: it becomes part of the game that is searched
+   Move move;
+
+   if ( false == findLegalMove(text, &move) )
+   {
+      return false;
+   }
+
+   unsigned long long iKeyBefore = m_iHashKey;
+
+   makeMove(move);
+
+   m_gameKeys.push_back(iKeyBefore);
+   m_iPly = 0;
+
+   return true;
+}
+
+bool Engine::findLegalMove(string text, Move* pMove)
+{
+   // Accepts both "e7e8q" (UCI) and "E7-E8=Q" (the format of the saved games)
+   string squares;
+   char   chPromoted = EMPTY_SQUARE;
+
+   for (unsigned i = 0; i < text.length(); i++)
+   {
+      char ch = toupper(text[i]);
+
+      if ( (ch >= 'A' && ch <= 'H') || (ch >= '1' && ch <= '8') )
+      {
+         if ( squares.length() < 4 )
+         {
+            squares += ch;
+         }
+         else
+         {
+            chPromoted = ch;
+         }
+      }
+      else if ( 'Q' == ch || 'R' == ch || 'N' == ch )
+      {
+         chPromoted = ch;
+      }
+   }
+
+   if ( squares.length() != 4 )
+   {
+      return false;
+   }
+
+   Position from = { squares[1] - '1', squares[0] - 'A' };
+   Position to   = { squares[3] - '1', squares[2] - 'A' };
+
+   MoveList list;
+   list.iCount = 0;
+   generateMoves(&list, ALL_MOVES);
+
+   for (int i = 0; i < list.iCount; i++)
+   {
+      Move move = list.moves[i].move;
+
+      if ( move.from.iRow != from.iRow || move.from.iColumn != from.iColumn ||
+           move.to.iRow   != to.iRow   || move.to.iColumn   != to.iColumn )
+      {
+         continue;
+      }
+
+      if ( toupper(move.chPromoted) != toupper(chPromoted) && EMPTY_SQUARE != move.chPromoted )
+      {
+         continue;
+      }
+
+      // Pseudo-legal is not enough
+      if ( false == makeMove(move) )
+      {
+         continue;
+      }
+
+      unmakeMove();
+
+      *pMove = move;
+      return true;
+   }
+
+   return false;
+}
+
+int Engine::getLegalMoves(Move* pMoves, int iMaxMoves)
+{
+   MoveList list;
+   list.iCount = 0;
+   generateMoves(&list, ALL_MOVES);
+
+   int iCount = 0;
+
+   for (int i = 0; i < list.iCount && iCount < iMaxMoves; i++)
+   {
+      if ( false == makeMove(list.moves[i].move) )
+      {
+         continue;
+      }
+
+      unmakeMove();
+
+      pMoves[iCount++] = list.moves[i].move;
+   }
+
+   return iCount;
+}
+
+bool Engine::think(int iMaxDepth, Move* pBestMove)
+{
+   Limits limits;
+   memset(&limits, 0, sizeof(Limits));
+
+   limits.iDepth = iMaxDepth;
+
+   return think(limits, pBestMove);
+}
+
+bool Engine::think(const Limits& limits, Move* pBestMove)
+{
+   int iColor = m_position.getCurrentTurn();
+
+   m_time.start(limits.iTime[iColor], limits.iIncrement[iColor], limits.iMovesToGo, limits.iMoveTime);
+   m_limits = limits;
+
+   m_iNodes          = 0;
+   m_iPly            = 0;
+   m_iBestPvLength   = 0;
+
+   memset(&m_stats, 0, sizeof(SearchStats));
+
+   m_iCheckCountdown = TimeManager::CHECK_INTERVAL;
+   m_bStopped        = false;
+   m_bPondering      = limits.bPonder;
+
+   if ( m_tt.getSizeInMegabytes() != m_iHashSize )
+   {
+      m_tt.resize(m_iHashSize);
+   }
+
+   int iMaxDepth = (limits.iDepth > 0) ? min(limits.iDepth, (int)MAX_PLY - 1) : MAX_PLY - 1;
+
+   memset(m_killers, 0, sizeof(m_killers));
+   memset(&m_rootBest, 0, sizeof(Move));
+
+   // Keep what was learned in previous searches, but with less weight
+   for (int i = 0; i < 2; i++)
+   {
+      for (int j = 0; j < 64; j++)
+      {
+         for (int k = 0; k < 64; k++)
+         {
+            m_history[i][j][k] /= 2;
+         }
+      }
+   }
+
+   // Iterative deepening: the best move of each iteration is tried first in the next one
+   for (int iDepth = 1; iDepth <= iMaxDepth; iDepth++)
+   {
+      int iScore = alphaBeta(iDepth, -INFINITE_SCORE, INFINITE_SCORE);
+
+      // An iteration that was interrupted can't be trusted
+      if ( true == m_bStopped )
+      {
+         break;
+      }
+
+      if ( 0 == m_iPvLength[0] )
+      {
+         // No legal moves, so it is either checkmate or stalemate
+         break;
+      }
+
+      bool bBestMoveChanged = ( iDepth > 1 && false == sameMove(m_rootBest, m_pv[0][0]) );
+
+      m_rootBest      = m_pv[0][0];
+      m_iBestPvLength = m_iPvLength[0];
+      memcpy(m_bestPv, m_pv[0], sizeof(Move) * m_iBestPvLength);
+
+      m_time.update(iScore, bBestMoveChanged);
+
+      long long iElapsed = m_time.getElapsed();
+
+      // What this iteration alone took
+      long long iPreviousNodes = 0;
+      long long iPreviousTime  = 0;
+
+      for (int i = 0; i < m_stats.iIterations; i++)
+      {
+         iPreviousNodes += m_stats.iIterationNodes[i];
+         iPreviousTime  += m_stats.iIterationTime[i];
+      }
+
+      m_stats.iIterationNodes[m_stats.iIterations] = m_iNodes - iPreviousNodes;
+      m_stats.iIterationTime[m_stats.iIterations]  = iElapsed - iPreviousTime;
+      m_stats.iIterations++;
+
+      if ( NULL != m_pfnInfo )
+      {
+         SearchInfo info;
+
+         info.iDepth    = iDepth;
+         info.iScore    = iScore;
+         info.iMateIn   = 0;
+         info.iNodes    = m_iNodes;
+         info.iTime     = iElapsed;
+         info.iPvLength = m_iBestPvLength;
+         memcpy(info.pv, m_bestPv, sizeof(Move) * m_iBestPvLength);
+
+         if ( iScore >= MATE_SCORE - MAX_PLY )
+         {
+            info.iMateIn = (MATE_SCORE - iScore + 1) / 2;
+         }
+         else if ( iScore <= -MATE_SCORE + MAX_PLY )
+         {
+            info.iMateIn = -(MATE_SCORE + iScore) / 2;
+         }
+
+         m_pfnInfo(info);
+      }
+
+      if ( abs(iScore) >= MATE_SCORE - MAX_PLY && false == limits.bInfinite )
+      {
+         // A forced mate was found, searching deeper will not change anything
+         break;
+      }
+
+      // Another iteration would hardly finish in the time that is left
+      if ( false == m_bPondering && true == m_time.isSoftLimitReached() )
+      {
+         break;
+      }
+   }
+
+   // When pondering or in infinite mode, the move is only given when asked for
+   while ( (true == m_bPondering || true == limits.bInfinite) && false == m_bStopRequested )
+   {
+      if ( true == m_bPondering && true == m_bPonderHit )
+      {
+         break;
+      }
+
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+   }
+
+   // Ready for the next search
+   m_bStopRequested = false;
+   m_bPonderHit     = false;
+   m_bPondering     = false;
+
+   if ( isNullMove(m_rootBest) )
+   {
+      return false;
+   }
+
+   *pBestMove = m_rootBest;
+
+   return true;
+}
+
+void Engine::prepareSearch(void)
+{
+   // Forget requests that arrived after the previous search was over
+   m_bStopRequested = false;
+   m_bPonderHit     = false;
+}
+
+void Engine::stop(void)
+{
+   m_bStopRequested = true;
+}
+
+void Engine::ponderhit(void)
+{
+   // The opponent played the move we were thinking about: from now on it's our time
+   m_bPonderHit = true;
+}
+
+void Engine::setInfoCallback(InfoCallback pfnCallback)
+{
+   m_pfnInfo = pfnCallback;
+}
+
+void Engine::setHashSize(int iMegabytes)
+{
+   m_iHashSize = max(1, iMegabytes);
+}
+
+bool Engine::setOption(string name, int iValue)
+{
+   if ( "Hash" == name )
+   {
+      setHashSize(iValue);
+   }
+   else if ( "NullMove" == name )
+   {
+      m_bUseNullMove = ( 0 != iValue );
+   }
+   else if ( "LMR" == name )
+   {
+      m_bUseLmr = ( 0 != iValue );
+   }
+   else
+   {
+      return false;
+   }
+
+   return true;
+}
+
+void Engine::clearHash(void)
+{
+   m_tt.clear();
+   memset(m_history, 0, sizeof(m_history));
+}
+
+long long Engine::getNodes(void)
+{
+   return m_iNodes;
+}
+
+void Engine::getSearchStats(SearchStats* pStats)
+{
+   *pStats = m_stats;
+   pStats->iNodes = m_iNodes;
+}
+
+string Engine::statsToJson(const SearchStats& stats)
+{
+   ostringstream oss;
+
+   oss << "{\"depth\":"  << stats.iIterations
+       << ",\"nodes\":"  << stats.iNodes
+       << ",\"qnodes\":" << stats.iQNodes;
+
+   // Rates as fractions, with three decimals
+   oss << std::fixed << std::setprecision(3);
+
+   oss << ",\"tt_hit_rate\":" << ( (stats.iTtProbes > 0) ? (double) stats.iTtHits / stats.iTtProbes : 0.0 );
+   oss << ",\"first_move_cutoff_rate\":" << ( (stats.iCutoffs > 0) ? (double) stats.iFirstMoveCutoffs / stats.iCutoffs : 0.0 );
+
+   // How many times more nodes the last iteration needed than the one before
+   double dBranchingFactor = 0.0;
+
+   if ( stats.iIterations > 1 && stats.iIterationNodes[stats.iIterations - 2] > 0 )
+   {
+      dBranchingFactor = (double) stats.iIterationNodes[stats.iIterations - 1] / stats.iIterationNodes[stats.iIterations - 2];
+   }
+
+   oss << ",\"branching_factor\":" << dBranchingFactor;
+
+   long long iTotalTime = 0;
+   oss << ",\"iterations\":[";
+
+   for (int i = 0; i < stats.iIterations; i++)
+   {
+      oss << ( (i > 0) ? "," : "" ) << "{\"depth\":" << (i + 1) << ",\"nodes\":" << stats.iIterationNodes[i] << ",\"time_ms\":" << stats.iIterationTime[i] << "}";
+      iTotalTime += stats.iIterationTime[i];
+   }
+
+   oss << "],\"time_ms\":" << iTotalTime << "}";
+
+   return oss.str();
+}
+
+int Engine::getPrincipalVariation(Move* pMoves, int iMaxMoves)
+{
+   int iCount = min(m_iBestPvLength, iMaxMoves);
+
+   for (int i = 0; i < iCount; i++)
+   {
+      pMoves[i] = m_bestPv[i];
+   }
+
+   return iCount;
+}
+
+string Engine::moveToUci(Move move)
+{
+   // e.g. "e2e4" or "e7e8q"
+   string text;
+
+   text += char('a' + move.from.iColumn);
+   text += char('1' + move.from.iRow);
+   text += char('a' + move.to.iColumn);
+   text += char('1' + move.to.iRow);
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      text += char(tolower(move.chPromoted));
+   }
+
+   return text;
+}
+
+string Engine::moveToString(Move move)
+{
+   // Same format used to log the moves, e.g. "E2-E4" or "E7-E8=Q"
+   string text;
+
+   text += char('A' + move.from.iColumn);
+   text += char('1' + move.from.iRow);
+   text += '-';
+   text += char('A' + move.to.iColumn);
+   text += char('1' + move.to.iRow);
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      text += '=';
+      text += char(toupper(move.chPromoted));
+   }
+
+   return text;
+}
+
+void Engine::applyMove(Game& game, Move move)
+{
+   // Fill in what isMoveValid() would, for a move the engine already knows to be legal
+   Chess::EnPassant S_enPassant = { 0 };
+   Chess::Castling  S_castling  = { 0 };
+   Chess::Promotion S_promotion = { 0 };
+
+   char chPiece = game.getPieceAtPosition(move.from);
+
+   if ( 'P' == toupper(chPiece) && move.from.iColumn != move.to.iColumn && EMPTY_SQUARE == game.getPieceAtPosition(move.to) )
+   {
+      S_enPassant.bApplied             = true;
+      S_enPassant.PawnCaptured.iRow    = move.from.iRow;
+      S_enPassant.PawnCaptured.iColumn = move.to.iColumn;
+   }
+
+   if ( 'K' == toupper(chPiece) && 2 == abs(move.to.iColumn - move.from.iColumn) )
+   {
+      S_castling.bApplied            = true;
+      S_castling.rook_before.iRow    = move.from.iRow;
+      S_castling.rook_before.iColumn = (6 == move.to.iColumn) ? 7 : 0;
+      S_castling.rook_after.iRow     = move.from.iRow;
+      S_castling.rook_after.iColumn  = (6 == move.to.iColumn) ? 5 : 3;
+   }
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      S_promotion.bApplied = true;
+      S_promotion.chBefore = chPiece;
+      S_promotion.chAfter  = move.chPromoted;
+   }
+
+   game.logMove(move.from, move.to, move.chPromoted);
+
+   game.movePiece(move.from, move.to, &S_enPassant, &S_castling, &S_promotion);
+}
+
+int Engine::getPieceIndex(char chPiece)
+{
+   // Same set of pieces known by describePiece()
+   switch (toupper(chPiece))
+   {
+      case 'P':
+      {
+         return 0;
+      }
+      break;
+
+      case 'N':
+      {
+         return 1;
+      }
+      break;
+
+      case 'B':
+      {
+         return 2;
+      }
+      break;
+
+      case 'R':
+      {
+         return 3;
+      }
+      break;
+
+      case 'Q':
+      {
+         return 4;
+      }
+      break;
+
+      default:
+      {
+         return 5;
+      }
+      break;
+   }
+}
+
+// -------------------------------------------------------------------
+// Move generation
+// -------------------------------------------------------------------
+void Engine::generateMoves(MoveList* pList, MoveKind kind)
+{
+   COUNT_CALL(COUNTER_GENERATE_MOVES);
+
+   int iColor = m_position.getCurrentTurn();
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         char chPiece = m_position.getPieceAtPosition(i, j);
+
+         if ( EMPTY_SQUARE == chPiece || iColor != getPieceColor(chPiece) )
+         {
+            continue;
+         }
+
+         Position from = { i, j };
+         generatePieceMoves(from, pList, kind);
+      }
+   }
+}
+
+void Engine::generatePieceMoves(Position from, MoveList* pList, MoveKind kind)
+{
+   char chPiece = m_position.getPieceAtPosition(from);
+   int  iColor  = getPieceColor(chPiece);
+
+   switch (toupper(chPiece))
+   {
+      case 'P':
+      {
+         int iDirection = (WHITE_PIECE == iColor) ? 1 : -1;
+         int iStartRow  = (WHITE_PIECE == iColor) ? 1 : 6;
+         int iLastRow   = (WHITE_PIECE == iColor) ? 7 : 0;
+         int iRow       = from.iRow + iDirection;
+
+         if ( iRow < 0 || iRow > 7 )
+         {
+            break;
+         }
+
+         // Move forward
+         if ( EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, from.iColumn) )
+         {
+            if ( iLastRow == iRow )
+            {
+               // Promotions are generated together with the captures
+               if ( QUIETS != kind )
+               {
+                  addPawnMove(pList, from, iRow, from.iColumn);
+               }
+            }
+            else if ( CAPTURES != kind )
+            {
+               addMove(pList, from, iRow, from.iColumn, kind);
+
+               // Double move forward, only from the original place
+               if ( iStartRow == from.iRow && EMPTY_SQUARE == m_position.getPieceAtPosition(iRow + iDirection, from.iColumn) )
+               {
+                  addMove(pList, from, iRow + iDirection, from.iColumn, kind);
+               }
+            }
+         }
+
+         if ( QUIETS == kind )
+         {
+            break;
+         }
+
+         // Capture diagonally (including "en passant")
+         for (int iSide = -1; iSide <= 1; iSide += 2)
+         {
+            int iColumn = from.iColumn + iSide;
+
+            if ( iColumn < 0 || iColumn > 7 )
+            {
+               continue;
+            }
+
+            char chTarget = m_position.getPieceAtPosition(iRow, iColumn);
+
+            if ( (EMPTY_SQUARE != chTarget && iColor != getPieceColor(chTarget)) ||
+                 (m_EnPassant.iRow == iRow && m_EnPassant.iColumn == iColumn) )
+            {
+               if ( iLastRow == iRow )
+               {
+                  addPawnMove(pList, from, iRow, iColumn);
+               }
+               else
+               {
+                  Move move = { from, { iRow, iColumn }, EMPTY_SQUARE };
+                  pList->moves[pList->iCount++].move = move;
+               }
+            }
+         }
+      }
+      break;
+
+      case 'N':
+      {
+         for (int i = 0; i < 8; i++)
+         {
+            int iRow    = from.iRow    + knight_offsets[i].iRow;
+            int iColumn = from.iColumn + knight_offsets[i].iColumn;
+
+            if ( iRow >= 0 && iRow <= 7 && iColumn >= 0 && iColumn <= 7 )
+            {
+               addMove(pList, from, iRow, iColumn, kind);
+            }
+         }
+      }
+      break;
+
+      case 'B':
+      case 'R':
+      case 'Q':
+      {
+         int iFirst = ('B' == toupper(chPiece)) ? 4 : 0;
+         int iLast  = ('R' == toupper(chPiece)) ? 4 : 8;
+
+         for (int i = iFirst; i < iLast; i++)
+         {
+            int iRow    = from.iRow    + slide_directions[i].iRow;
+            int iColumn = from.iColumn + slide_directions[i].iColumn;
+
+            while ( iRow >= 0 && iRow <= 7 && iColumn >= 0 && iColumn <= 7 )
+            {
+               addMove(pList, from, iRow, iColumn, kind);
+
+               if ( EMPTY_SQUARE != m_position.getPieceAtPosition(iRow, iColumn) )
+               {
+                  // Can't go any further in this direction
+                  break;
+               }
+
+               iRow    += slide_directions[i].iRow;
+               iColumn += slide_directions[i].iColumn;
+            }
+         }
+      }
+      break;
+
+      case 'K':
+      {
+         for (int i = 0; i < 8; i++)
+         {
+            int iRow    = from.iRow    + king_offsets[i].iRow;
+            int iColumn = from.iColumn + king_offsets[i].iColumn;
+
+            if ( iRow >= 0 && iRow <= 7 && iColumn >= 0 && iColumn <= 7 )
+            {
+               addMove(pList, from, iRow, iColumn, kind);
+            }
+         }
+
+         if ( CAPTURES != kind )
+         {
+            addCastling(pList, from, iColor);
+         }
+      }
+      break;
+   }
+}
+
+void Engine::addMove(MoveList* pList, Position from, int iRow, int iColumn, MoveKind kind)
+{
+   char chTarget = m_position.getPieceAtPosition(iRow, iColumn);
+
+   if ( EMPTY_SQUARE == chTarget )
+   {
+      if ( CAPTURES == kind )
+      {
+         return;
+      }
+   }
+   else if ( getPieceColor(chTarget) == getPieceColor(m_position.getPieceAtPosition(from)) )
+   {
+      // Can't capture a piece of the same color
+      return;
+   }
+   else if ( QUIETS == kind )
+   {
+      return;
+   }
+
+   Move move = { from, { iRow, iColumn }, EMPTY_SQUARE };
+   pList->moves[pList->iCount++].move = move;
+}
+
+void Engine::addPawnMove(MoveList* pList, Position from, int iRow, int iColumn)
+{
+   // A pawn that reaches its eight rank can be promoted to any of these
+   const char promotions[4] = { 'Q', 'N', 'R', 'B' };
+
+   for (int i = 0; i < 4; i++)
+   {
+      Move move = { from, { iRow, iColumn }, promotions[i] };
+
+      if ( BLACK_PIECE == getPieceColor(m_position.getPieceAtPosition(from)) )
+      {
+         move.chPromoted = tolower(move.chPromoted);
+      }
+
+      pList->moves[pList->iCount++].move = move;
+   }
+}
+
+void Engine::addCastling(MoveList* pList, Position king, int iColor)
+{
+   int  iRow   = (WHITE_PIECE == iColor) ? 0 : 7;
+   char chRook = (WHITE_PIECE == iColor) ? 'R' : 'r';
+
+   if ( iRow != king.iRow || 4 != king.iColumn )
+   {
+      return;
+   }
+
+   // The king can't castle out of check
+   if ( true == inCheck() )
+   {
+      return;
+   }
+
+   // King side: the rook must be there, the squares in between free and the one the king skips not attacked
+   if ( true   == m_position.castlingAllowed(KING_SIDE, iColor)          &&
+        chRook == m_position.getPieceAtPosition(iRow, 7)                 &&
+        EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, 5)           &&
+        EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, 6)           &&
+        false  == m_position.isUnderAttack(iRow, 5, iColor).bUnderAttack )
+   {
+      Move move = { king, { iRow, 6 }, EMPTY_SQUARE };
+      pList->moves[pList->iCount++].move = move;
+   }
+
+   // Queen side
+   if ( true   == m_position.castlingAllowed(QUEEN_SIDE, iColor)         &&
+        chRook == m_position.getPieceAtPosition(iRow, 0)                 &&
+        EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, 1)           &&
+        EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, 2)           &&
+        EMPTY_SQUARE == m_position.getPieceAtPosition(iRow, 3)           &&
+        false  == m_position.isUnderAttack(iRow, 3, iColor).bUnderAttack )
+   {
+      Move move = { king, { iRow, 2 }, EMPTY_SQUARE };
+      pList->moves[pList->iCount++].move = move;
+   }
+}
+
+bool Engine::isPseudoLegal(Move move, MoveKind kind)
+{
+   char chPiece = m_position.getPieceAtPosition(move.from);
+
+   if ( EMPTY_SQUARE == chPiece || m_position.getCurrentTurn() != getPieceColor(chPiece) )
+   {
+      return false;
+   }
+
+   // Moves coming from the killers (or from another position) are only tried
+   // if the piece could really make that move here
+   MoveList list;
+   list.iCount = 0;
+   generatePieceMoves(move.from, &list, kind);
+
+   for (int i = 0; i < list.iCount; i++)
+   {
+      if ( sameMove(list.moves[i].move, move) )
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+// -------------------------------------------------------------------
+// Move ordering
+// -------------------------------------------------------------------
+void Engine::initPicker(MovePicker* pPicker, Move* pBestMove, bool bCapturesOnly)
+{
+   pPicker->stage         = STAGE_BEST_MOVE;
+   pPicker->bCapturesOnly = bCapturesOnly;
+   pPicker->iKiller       = 0;
+   pPicker->iCurrent      = 0;
+   pPicker->list.iCount   = 0;
+
+   pPicker->iNumBadCaptures    = 0;
+   pPicker->iCurrentBadCapture = 0;
+
+   if ( NULL != pBestMove )
+   {
+      pPicker->best_move = *pBestMove;
+   }
+   else
+   {
+      memset(&pPicker->best_move, 0, sizeof(Move));
+   }
+}
+
+bool Engine::nextMove(MovePicker* pPicker, Move* pMove)
+{
+   while ( true )
+   {
+      switch (pPicker->stage)
+      {
+         case STAGE_BEST_MOVE:
+         {
+            pPicker->stage = STAGE_GENERATE_CAPTURES;
+
+            if ( false == isNullMove(pPicker->best_move) && true == isPseudoLegal(pPicker->best_move, ALL_MOVES) )
+            {
+               *pMove = pPicker->best_move;
+               return true;
+            }
+         }
+         break;
+
+         case STAGE_GENERATE_CAPTURES:
+         {
+            pPicker->list.iCount = 0;
+            pPicker->iCurrent    = 0;
+            generateMoves(&pPicker->list, CAPTURES);
+
+            // MVV-LVA: most valuable victim first, and among those the least valuable attacker
+            for (int i = 0; i < pPicker->list.iCount; i++)
+            {
+               Move move       = pPicker->list.moves[i].move;
+               char chAttacker = m_position.getPieceAtPosition(move.from);
+               char chVictim   = m_position.getPieceAtPosition(move.to);
+
+               int iScore = 0;
+
+               if ( EMPTY_SQUARE != chVictim )
+               {
+                  iScore += 8 * piece_value[getPieceIndex(chVictim)];
+               }
+               else if ( EMPTY_SQUARE == move.chPromoted )
+               {
+                  // "En passant"
+                  iScore += 8 * piece_value[0];
+               }
+
+               if ( EMPTY_SQUARE != move.chPromoted )
+               {
+                  iScore += 8 * piece_value[getPieceIndex(move.chPromoted)];
+               }
+
+               iScore -= getPieceIndex(chAttacker);
+
+               pPicker->list.moves[i].iScore = iScore;
+            }
+
+            pPicker->stage = STAGE_CAPTURES;
+         }
+         break;
+
+         case STAGE_CAPTURES:
+         {
+            while ( true == pickBest(pPicker, pMove) )
+            {
+               if ( true == sameMove(*pMove, pPicker->best_move) )
+               {
+                  continue;
+               }
+
+               // Captures that lose material are left for the end (or never tried, in the quiescence search)
+               if ( see(*pMove) < 0 )
+               {
+                  if ( false == pPicker->bCapturesOnly )
+                  {
+                     pPicker->bad_captures[pPicker->iNumBadCaptures++] = *pMove;
+                  }
+                  continue;
+               }
+
+               return true;
+            }
+
+            pPicker->stage = pPicker->bCapturesOnly ? STAGE_DONE : STAGE_KILLERS;
+         }
+         break;
+
+         case STAGE_KILLERS:
+         {
+            while ( pPicker->iKiller < 2 )
+            {
+               Move killer = m_killers[m_iPly][pPicker->iKiller++];
+
+               if ( false == isNullMove(killer)                    &&
+                    false == sameMove(killer, pPicker->best_move)  &&
+                    true  == isPseudoLegal(killer, QUIETS)         )
+               {
+                  *pMove = killer;
+                  return true;
+               }
+            }
+
+            pPicker->stage = STAGE_GENERATE_QUIETS;
+         }
+         break;
+
+         case STAGE_GENERATE_QUIETS:
+         {
+            pPicker->list.iCount = 0;
+            pPicker->iCurrent    = 0;
+            generateMoves(&pPicker->list, QUIETS);
+
+            // Quiet moves are ordered by how often they caused a cutoff before
+            int iColor = m_position.getCurrentTurn();
+
+            for (int i = 0; i < pPicker->list.iCount; i++)
+            {
+               Move move = pPicker->list.moves[i].move;
+
+               pPicker->list.moves[i].iScore = m_history[iColor][move.from.iRow * 8 + move.from.iColumn][move.to.iRow * 8 + move.to.iColumn];
+            }
+
+            pPicker->stage = STAGE_QUIETS;
+         }
+         break;
+
+         case STAGE_QUIETS:
+         {
+            while ( true == pickBest(pPicker, pMove) )
+            {
+               if ( false == sameMove(*pMove, pPicker->best_move)    &&
+                    false == sameMove(*pMove, m_killers[m_iPly][0])  &&
+                    false == sameMove(*pMove, m_killers[m_iPly][1])  )
+               {
+                  return true;
+               }
+            }
+
+            pPicker->stage = STAGE_BAD_CAPTURES;
+         }
+         break;
+
+         case STAGE_BAD_CAPTURES:
+         {
+            if ( pPicker->iCurrentBadCapture < pPicker->iNumBadCaptures )
+            {
+               *pMove = pPicker->bad_captures[pPicker->iCurrentBadCapture++];
+               return true;
+            }
+
+            pPicker->stage = STAGE_DONE;
+         }
+         break;
+
+         case STAGE_DONE:
+         {
+            return false;
+         }
+         break;
+      }
+   }
+}
+
+bool Engine::pickBest(MovePicker* pPicker, Move* pMove)
+{
+   if ( pPicker->iCurrent >= pPicker->list.iCount )
+   {
+      return false;
+   }
+
+   // Selection sort, one move at a time: if there is a cutoff, the rest is never sorted
+   int iBest = pPicker->iCurrent;
+
+   for (int i = pPicker->iCurrent + 1; i < pPicker->list.iCount; i++)
+   {
+      if ( pPicker->list.moves[i].iScore > pPicker->list.moves[iBest].iScore )
+      {
+         iBest = i;
+      }
+   }
+
+   ScoredMove aux = pPicker->list.moves[pPicker->iCurrent];
+   pPicker->list.moves[pPicker->iCurrent] = pPicker->list.moves[iBest];
+   pPicker->list.moves[iBest] = aux;
+
+   *pMove = pPicker->list.moves[pPicker->iCurrent++].move;
+
+   return true;
+}
+
+bool Engine::isCapture(Move move)
+{
+   // Promotions are treated as captures, they are never quiet
+   if ( EMPTY_SQUARE != m_position.getPieceAtPosition(move.to) || EMPTY_SQUARE != move.chPromoted )
+   {
+      return true;
+   }
+
+   // "En passant"
+   return ( 'P' == toupper(m_position.getPieceAtPosition(move.from)) && move.from.iColumn != move.to.iColumn );
+}
+
+int Engine::see(Move move)
+{
+   // Static exchange evaluation: what the side to move wins (or loses) if both sides keep
+   // capturing on the destination square, always with their least valuable attacker
+   char chAttacker = m_position.getPieceAtPosition(move.from);
+   char chVictim   = m_position.getPieceAtPosition(move.to);
+
+   int iVictimValue   = 0;
+   int iAttackerValue = see_value[getPieceIndex(chAttacker)];
+
+   if ( EMPTY_SQUARE != chVictim )
+   {
+      iVictimValue = see_value[getPieceIndex(chVictim)];
+   }
+   else if ( 'P' == toupper(chAttacker) && move.from.iColumn != move.to.iColumn )
+   {
+      // "En passant". A pawn moving straight (a quiet promotion) captures nothing
+      iVictimValue = see_value[0];
+   }
+
+   // Taking something at least as valuable can never lose material
+   if ( iVictimValue >= iAttackerValue && EMPTY_SQUARE == move.chPromoted )
+   {
+      return iVictimValue - iAttackerValue;
+   }
+
+   // Pieces are taken off the board as they capture, so the ones behind them (x-rays)
+   // are found by isUnderAttack(). They are all put back at the end
+   struct Removed
+   {
+      Position pos;
+      char     chPiece;
+   } removed[32];
+
+   int iNumRemoved = 0;
+
+   removed[iNumRemoved].pos       = move.from;
+   removed[iNumRemoved++].chPiece = chAttacker;
+   m_position.setPieceAtPosition(move.from.iRow, move.from.iColumn, EMPTY_SQUARE);
+
+   int  gain[32];
+   int  iDepth    = 0;
+   char chOnSquare = chAttacker;
+
+   gain[0] = iVictimValue;
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      gain[0]   += see_value[getPieceIndex(move.chPromoted)] - see_value[0];
+      chOnSquare = move.chPromoted;
+   }
+
+   int iSide = (WHITE_PIECE == getPieceColor(chAttacker)) ? BLACK_PIECE : WHITE_PIECE;
+
+   while ( iDepth < 31 && iNumRemoved < 32 )
+   {
+      // Attackers of iSide are the pieces that put a piece of the other color in jeopardy
+      UnderAttack attack = m_position.isUnderAttack(move.to.iRow, move.to.iColumn, (WHITE_PIECE == iSide) ? BLACK_PIECE : WHITE_PIECE);
+
+      Position least;
+      int      iLeast = -1;
+
+      for (int i = 0; i < attack.iNumAttackers; i++)
+      {
+         int iIndex = getPieceIndex(m_position.getPieceAtPosition(attack.attacker[i].pos));
+
+         if ( -1 == iLeast || iIndex < iLeast )
+         {
+            iLeast = iIndex;
+            least  = attack.attacker[i].pos;
+         }
+      }
+
+      // isUnderAttack() does not consider the king, so it is the last resort
+      if ( -1 == iLeast )
+      {
+         Position king = m_King[iSide];
+
+         if ( abs(king.iRow - move.to.iRow) <= 1 && abs(king.iColumn - move.to.iColumn) <= 1 &&
+              iSide == getPieceColor(m_position.getPieceAtPosition(king)) &&
+              'K' == toupper(m_position.getPieceAtPosition(king)) )
+         {
+            iLeast = 5;
+            least  = king;
+         }
+      }
+
+      if ( -1 == iLeast )
+      {
+         break;
+      }
+
+      iDepth++;
+      gain[iDepth] = see_value[getPieceIndex(chOnSquare)] - gain[iDepth - 1];
+
+      // Neither side can gain anything by going on
+      if ( max(-gain[iDepth - 1], gain[iDepth]) < 0 )
+      {
+         break;
+      }
+
+      chOnSquare = m_position.getPieceAtPosition(least);
+
+      removed[iNumRemoved].pos       = least;
+      removed[iNumRemoved++].chPiece = chOnSquare;
+      m_position.setPieceAtPosition(least.iRow, least.iColumn, EMPTY_SQUARE);
+
+      iSide = (WHITE_PIECE == iSide) ? BLACK_PIECE : WHITE_PIECE;
+   }
+
+   // Each side can stop capturing when it is better off that way
+   while ( iDepth > 0 )
+   {
+      gain[iDepth - 1] = -max(-gain[iDepth - 1], gain[iDepth]);
+      iDepth--;
+   }
+
+   for (int i = 0; i < iNumRemoved; i++)
+   {
+      m_position.setPieceAtPosition(removed[i].pos.iRow, removed[i].pos.iColumn, removed[i].chPiece);
+   }
+
+   return gain[0];
+}
+
+void Engine::updateQuietStats(Move move, int iDepth)
+{
+   // Killers: quiet moves that caused a cutoff on the same ply
+   if ( false == sameMove(move, m_killers[m_iPly][0]) )
+   {
+      m_killers[m_iPly][1] = m_killers[m_iPly][0];
+      m_killers[m_iPly][0] = move;
+   }
+
+   // History: the deeper the cutoff, the more it counts
+   int* pHistory = &m_history[m_position.getCurrentTurn()][move.from.iRow * 8 + move.from.iColumn][move.to.iRow * 8 + move.to.iColumn];
+
+   *pHistory += iDepth * iDepth;
+
+   if ( *pHistory > 1000000 )
+   {
+      for (int i = 0; i < 2; i++)
+      {
+         for (int j = 0; j < 64; j++)
+         {
+            for (int k = 0; k < 64; k++)
+            {
+               m_history[i][j][k] /= 2;
+            }
+         }
+      }
+   }
+}
+
+// -------------------------------------------------------------------
+// Make and unmake moves
+// -------------------------------------------------------------------
+bool Engine::makeMove(Move move)
+{
+   State* pState = &m_state[m_iPly];
+   int    iColor = m_position.getCurrentTurn();
+   char   chPiece = m_position.getPieceAtPosition(move.from);
+
+   pState->move        = move;
+   pState->bNullMove   = false;
+   pState->chMoved     = chPiece;
+   pState->en_passant  = m_EnPassant;
+   pState->captured_at = move.to;
+   pState->iHashKey    = m_iHashKey;
+
+   for (int i = 0; i < 2; i++)
+   {
+      pState->bCastlingKingSideAllowed[i]  = m_position.castlingAllowed(KING_SIDE,  i);
+      pState->bCastlingQueenSideAllowed[i] = m_position.castlingAllowed(QUEEN_SIDE, i);
+   }
+
+   // A pawn moving diagonally to an empty square is an "en passant" capture
+   if ( 'P' == toupper(chPiece) && move.from.iColumn != move.to.iColumn && EMPTY_SQUARE == m_position.getPieceAtPosition(move.to) )
+   {
+      pState->captured_at.iRow = move.from.iRow;
+   }
+
+   pState->chCaptured = m_position.getPieceAtPosition(pState->captured_at);
+
+   if ( EMPTY_SQUARE != pState->chCaptured )
+   {
+      m_iMaterial[getPieceColor(pState->chCaptured)][getPieceIndex(pState->chCaptured)]--;
+   }
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      m_iMaterial[iColor][0]--;
+      m_iMaterial[iColor][getPieceIndex(move.chPromoted)]++;
+   }
+
+   // The hash key is updated along with the board: what is about to change is taken out first
+   unsigned long long iKey = m_iHashKey ^ zobrist.castling[getCastlingRights()] ^ zobrist.side;
+
+   if ( -1 != m_EnPassant.iRow )
+   {
+      iKey ^= zobrist.en_passant[m_EnPassant.iColumn];
+   }
+
+   if ( EMPTY_SQUARE != pState->chCaptured )
+   {
+      iKey ^= zobrist.piece[getZobristIndex(pState->chCaptured)][pState->captured_at.iRow * 8 + pState->captured_at.iColumn];
+   }
+
+   iKey ^= zobrist.piece[getZobristIndex(chPiece)][move.from.iRow * 8 + move.from.iColumn];
+   iKey ^= zobrist.piece[getZobristIndex((EMPTY_SQUARE != move.chPromoted) ? move.chPromoted : chPiece)][move.to.iRow * 8 + move.to.iColumn];
+
+   // Move the piece
+   m_position.setPieceAtPosition(pState->captured_at.iRow, pState->captured_at.iColumn, EMPTY_SQUARE);
+   m_position.setPieceAtPosition(move.from.iRow, move.from.iColumn, EMPTY_SQUARE);
+   m_position.setPieceAtPosition(move.to.iRow, move.to.iColumn, (EMPTY_SQUARE != move.chPromoted) ? move.chPromoted : chPiece);
+
+   if ( 'K' == toupper(chPiece) )
+   {
+      m_King[iColor] = move.to;
+
+      m_position.setCastlingAllowed(KING_SIDE,  iColor, false);
+      m_position.setCastlingAllowed(QUEEN_SIDE, iColor, false);
+
+      // Castling: the rook 'jumps' the king
+      if ( 2 == abs(move.to.iColumn - move.from.iColumn) )
+      {
+         int iRookBefore = (6 == move.to.iColumn) ? 7 : 0;
+         int iRookAfter  = (6 == move.to.iColumn) ? 5 : 3;
+
+         char chRook = m_position.getPieceAtPosition(move.to.iRow, iRookBefore);
+
+         m_position.setPieceAtPosition(move.to.iRow, iRookAfter, chRook);
+         m_position.setPieceAtPosition(move.to.iRow, iRookBefore, EMPTY_SQUARE);
+
+         iKey ^= zobrist.piece[getZobristIndex(chRook)][move.to.iRow * 8 + iRookBefore];
+         iKey ^= zobrist.piece[getZobristIndex(chRook)][move.to.iRow * 8 + iRookAfter];
+      }
+   }
+
+   // Anything moving from or to a corner means that rook can't castle anymore
+   const Position corners[4] = { { 0, 0 }, { 0, 7 }, { 7, 0 }, { 7, 7 } };
+
+   for (int i = 0; i < 4; i++)
+   {
+      if ( (corners[i].iRow == move.from.iRow && corners[i].iColumn == move.from.iColumn) ||
+           (corners[i].iRow == move.to.iRow   && corners[i].iColumn == move.to.iColumn) )
+      {
+         m_position.setCastlingAllowed((0 == corners[i].iColumn) ? QUEEN_SIDE : KING_SIDE,
+                                       (0 == corners[i].iRow)    ? WHITE_PIECE : BLACK_PIECE,
+                                       false);
+      }
+   }
+
+   // After a double move forward, the opponent might capture "en passant"
+   if ( 'P' == toupper(chPiece) && 2 == abs(move.to.iRow - move.from.iRow) )
+   {
+      m_EnPassant.iRow    = (move.from.iRow + move.to.iRow) / 2;
+      m_EnPassant.iColumn = move.from.iColumn;
+   }
+   else
+   {
+      m_EnPassant.iRow    = -1;
+      m_EnPassant.iColumn = -1;
+   }
+
+   iKey ^= zobrist.castling[getCastlingRights()];
+
+   if ( -1 != m_EnPassant.iRow )
+   {
+      iKey ^= zobrist.en_passant[m_EnPassant.iColumn];
+   }
+
+   m_iHashKey = iKey;
+
+   m_position.changeTurns();
+   m_iPly++;
+
+   // The move is only legal if it does not leave the king in check.
+   // isUnderAttack() does not consider the other king, so that must be checked apart
+   bool bLegal = ( false == m_position.isUnderAttack(m_King[iColor].iRow, m_King[iColor].iColumn, iColor).bUnderAttack );
+
+   if ( true == bLegal && 'K' == toupper(chPiece) )
+   {
+      bLegal = ( abs(m_King[WHITE_PIECE].iRow    - m_King[BLACK_PIECE].iRow)    > 1 ||
+                 abs(m_King[WHITE_PIECE].iColumn - m_King[BLACK_PIECE].iColumn) > 1 );
+   }
+
+   if ( false == bLegal )
+   {
+      unmakeMove();
+      return false;
+   }
+
+   m_iNodes++;
+
+   return true;
+}
+
+void Engine::unmakeMove(void)
+{
+   m_iPly--;
+   m_position.changeTurns();
+
+   State* pState = &m_state[m_iPly];
+   Move   move   = pState->move;
+   int    iColor = m_position.getCurrentTurn();
+
+   // Put the pieces back
+   m_position.setPieceAtPosition(move.from.iRow, move.from.iColumn, pState->chMoved);
+   m_position.setPieceAtPosition(move.to.iRow, move.to.iColumn, EMPTY_SQUARE);
+   m_position.setPieceAtPosition(pState->captured_at.iRow, pState->captured_at.iColumn, pState->chCaptured);
+
+   if ( EMPTY_SQUARE != pState->chCaptured )
+   {
+      m_iMaterial[getPieceColor(pState->chCaptured)][getPieceIndex(pState->chCaptured)]++;
+   }
+
+   if ( EMPTY_SQUARE != move.chPromoted )
+   {
+      m_iMaterial[iColor][0]++;
+      m_iMaterial[iColor][getPieceIndex(move.chPromoted)]--;
+   }
+
+   if ( 'K' == toupper(pState->chMoved) )
+   {
+      m_King[iColor] = move.from;
+
+      if ( 2 == abs(move.to.iColumn - move.from.iColumn) )
+      {
+         int iRookBefore = (6 == move.to.iColumn) ? 7 : 0;
+         int iRookAfter  = (6 == move.to.iColumn) ? 5 : 3;
+
+         m_position.setPieceAtPosition(move.to.iRow, iRookBefore, m_position.getPieceAtPosition(move.to.iRow, iRookAfter));
+         m_position.setPieceAtPosition(move.to.iRow, iRookAfter, EMPTY_SQUARE);
+      }
+   }
+
+   m_EnPassant = pState->en_passant;
+   m_iHashKey  = pState->iHashKey;
+
+   for (int i = 0; i < 2; i++)
+   {
+      m_position.setCastlingAllowed(KING_SIDE,  i, pState->bCastlingKingSideAllowed[i]);
+      m_position.setCastlingAllowed(QUEEN_SIDE, i, pState->bCastlingQueenSideAllowed[i]);
+   }
+}
+
+void Engine::makeNullMove(void)
+{
+   // Pass the turn to the opponent without moving anything
+   State* pState = &m_state[m_iPly];
+
+   memset(&pState->move, 0, sizeof(Move));
+   pState->bNullMove  = true;
+   pState->en_passant = m_EnPassant;
+   pState->iHashKey   = m_iHashKey;
+
+   m_iHashKey ^= zobrist.side;
+
+   if ( -1 != m_EnPassant.iRow )
+   {
+      m_iHashKey ^= zobrist.en_passant[m_EnPassant.iColumn];
+   }
+
+   m_EnPassant.iRow    = -1;
+   m_EnPassant.iColumn = -1;
+
+   m_position.changeTurns();
+   m_iPly++;
+}
+
+void Engine::unmakeNullMove(void)
+{
+   m_iPly--;
+   m_position.changeTurns();
+
+   m_EnPassant = m_state[m_iPly].en_passant;
+   m_iHashKey  = m_state[m_iPly].iHashKey;
+}
+
+bool Engine::hasNonPawnMaterial(int iColor)
+{
+   return ( m_iMaterial[iColor][1] + m_iMaterial[iColor][2] + m_iMaterial[iColor][3] + m_iMaterial[iColor][4] > 0 );
+}
+
+bool Engine::inCheck(void)
+{
+   int iColor = m_position.getCurrentTurn();
+
+   return m_position.isUnderAttack(m_King[iColor].iRow, m_King[iColor].iColumn, iColor).bUnderAttack;
+}
+
+// -------------------------------------------------------------------
+// Hashing
+// -------------------------------------------------------------------
+unsigned long long Engine::computeHashKey(void)
+{
+   // From scratch. During the search the key is updated in makeMove()
+   unsigned long long iKey = 0;
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         char chPiece = m_position.getPieceAtPosition(i, j);
+
+         if ( EMPTY_SQUARE != chPiece )
+         {
+            iKey ^= zobrist.piece[getZobristIndex(chPiece)][i * 8 + j];
+         }
+      }
+   }
+
+   if ( BLACK_PLAYER == m_position.getCurrentTurn() )
+   {
+      iKey ^= zobrist.side;
+   }
+
+   iKey ^= zobrist.castling[getCastlingRights()];
+
+   if ( -1 != m_EnPassant.iRow )
+   {
+      iKey ^= zobrist.en_passant[m_EnPassant.iColumn];
+   }
+
+   return iKey;
+}
+
+int Engine::getCastlingRights(void)
+{
+   // One bit for each of the four castlings
+   int iRights = 0;
+
+   if ( m_position.castlingAllowed(KING_SIDE,  WHITE_PIECE) ) iRights |= 1;
+   if ( m_position.castlingAllowed(QUEEN_SIDE, WHITE_PIECE) ) iRights |= 2;
+   if ( m_position.castlingAllowed(KING_SIDE,  BLACK_PIECE) ) iRights |= 4;
+   if ( m_position.castlingAllowed(QUEEN_SIDE, BLACK_PIECE) ) iRights |= 8;
+
+   return iRights;
+}
+
+bool Engine::isRepetition(void)
+{
+   // Only positions with the same side to move can be the same.
+   // A null move breaks the chain, what came before it was not really played
+   int iGameKeys = (int)m_gameKeys.size();
+
+   for (int iPly = m_iPly - 1; iPly >= -iGameKeys; iPly--)
+   {
+      unsigned long long iKey;
+
+      if ( iPly >= 0 )
+      {
+         if ( true == m_state[iPly].bNullMove )
+         {
+            return false;
+         }
+
+         iKey = m_state[iPly].iHashKey;
+      }
+      else
+      {
+         iKey = m_gameKeys[iGameKeys + iPly];
+      }
+
+      if ( 0 == (m_iPly - iPly) % 2 && iKey == m_iHashKey )
+      {
+         return true;
+      }
+   }
+
+   return false;
+}
+
+unsigned short Engine::packMove(Move move)
+{
+   // 6 bits for each square and 3 for the promotion. Zero is "no move"
+   if ( true == isNullMove(move) )
+   {
+      return 0;
+   }
+
+   int iPromoted = 0;
+
+   switch (toupper(move.chPromoted))
+   {
+      case 'N': iPromoted = 1; break;
+      case 'B': iPromoted = 2; break;
+      case 'R': iPromoted = 3; break;
+      case 'Q': iPromoted = 4; break;
+   }
+
+   return (unsigned short)((move.from.iRow * 8 + move.from.iColumn) |
+                           ((move.to.iRow * 8 + move.to.iColumn) << 6) |
+                           (iPromoted << 12));
+}
+
+Engine::Move Engine::unpackMove(unsigned short iMove)
+{
+   const char promotions[5] = { EMPTY_SQUARE, 'N', 'B', 'R', 'Q' };
+
+   Move move;
+
+   move.from.iRow      = (iMove & 63) / 8;
+   move.from.iColumn   = (iMove & 63) % 8;
+   move.to.iRow        = ((iMove >> 6) & 63) / 8;
+   move.to.iColumn     = ((iMove >> 6) & 63) % 8;
+   move.chPromoted     = promotions[min((iMove >> 12) & 7, 4)];
+
+   // The color of the promoted piece is the color of the side to move
+   if ( EMPTY_SQUARE != move.chPromoted && BLACK_PLAYER == m_position.getCurrentTurn() )
+   {
+      move.chPromoted = tolower(move.chPromoted);
+   }
+
+   return move;
+}
+
+void Engine::checkLimits(void)
+{
+   // The first iteration always finishes, so there is a move to play
+   if ( 0 == m_iBestPvLength )
+   {
+      return;
+   }
+
+   if ( true == m_bStopRequested )
+   {
+      m_bStopped = true;
+   }
+
+   if ( true == m_bPondering )
+   {
+      if ( false == m_bPonderHit )
+      {
+         // The clock is not running yet
+         return;
+      }
+
+      m_bPondering = false;
+      m_time.restart();
+   }
+
+   if ( m_limits.iNodes > 0 && m_iNodes >= m_limits.iNodes )
+   {
+      m_bStopped = true;
+   }
+
+   // Reading the clock is expensive, so it is only done once in a while
+   if ( --m_iCheckCountdown > 0 )
+   {
+      return;
+   }
+
+   m_iCheckCountdown = TimeManager::CHECK_INTERVAL;
+
+   if ( true == m_time.isHardLimitReached() )
+   {
+      m_bStopped = true;
+   }
+}
+
+// -------------------------------------------------------------------
+// Search
+// -------------------------------------------------------------------
+int Engine::alphaBeta(int iDepth, int iAlpha, int iBeta)
+{
+   m_iPvLength[m_iPly] = 0;
+
+   if ( iDepth <= 0 )
+   {
+      return quiesce(iAlpha, iBeta);
+   }
+
+   if ( m_iPly >= MAX_PLY - 1 )
+   {
+      return evaluate();
+   }
+
+   checkLimits();
+
+   if ( true == m_bStopped )
+   {
+      return 0;
+   }
+
+   // A position that was seen before is a draw (the opponent can repeat it again)
+   if ( m_iPly > 0 && true == isRepetition() )
+   {
+      return 0;
+   }
+
+   bool bInCheck = inCheck();
+   bool bPvNode  = ( iBeta - iAlpha > 1 );
+   int  iAlphaOriginal = iAlpha;
+
+   // ----------------------------------------------------------------
+   // Transposition table: the same position may have been searched
+   // already, through another order of moves or in a previous iteration
+   // ----------------------------------------------------------------
+   TranspositionTable::Entry entry;
+   Move hash_move;
+   memset(&hash_move, 0, sizeof(Move));
+
+   m_stats.iTtProbes++;
+
+   if ( true == m_tt.probe(m_iHashKey, &entry) )
+   {
+      m_stats.iTtHits++;
+
+      hash_move = unpackMove(entry.iMove);
+
+      // Mate scores are stored relative to the position, not to the root
+      int iScore = entry.iScore;
+
+      if ( iScore >= MATE_SCORE - MAX_PLY )
+      {
+         iScore -= m_iPly;
+      }
+      else if ( iScore <= -MATE_SCORE + MAX_PLY )
+      {
+         iScore += m_iPly;
+      }
+
+      if ( false == bPvNode && entry.iDepth >= iDepth )
+      {
+         if ( TranspositionTable::BOUND_EXACT == entry.iBound                       ||
+              (TranspositionTable::BOUND_LOWER == entry.iBound && iScore >= iBeta)  ||
+              (TranspositionTable::BOUND_UPPER == entry.iBound && iScore <= iAlpha) )
+         {
+            return iScore;
+         }
+      }
+   }
+
+   // ----------------------------------------------------------------
+   // Null move: if passing the turn is still good enough for a cutoff,
+   // a real move will be too. Not done when the side to move has only
+   // pawns left, because then zugzwang is common
+   // ----------------------------------------------------------------
+   if ( true == m_bUseNullMove && false == bPvNode && false == bInCheck && iDepth >= 3 && m_iPly > 0 &&
+        false == m_state[m_iPly - 1].bNullMove                              &&
+        true  == hasNonPawnMaterial(m_position.getCurrentTurn())            &&
+        evaluate() >= iBeta )
+   {
+      int iReduction = (iDepth > 6) ? 3 : 2;
+
+      makeNullMove();
+      int iScore = -alphaBeta(iDepth - 1 - iReduction, -iBeta, -iBeta + 1);
+      unmakeNullMove();
+
+      if ( true == m_bStopped )
+      {
+         return 0;
+      }
+
+      if ( iScore >= iBeta )
+      {
+         // Don't trust mate scores found without a real move
+         return (iScore >= MATE_SCORE - MAX_PLY) ? iBeta : iScore;
+      }
+   }
+
+   // At the root, the best move from the previous iteration goes first.
+   // Everywhere else, the move the transposition table remembers
+   MovePicker* pPicker = &m_picker[m_iPly];
+   initPicker(pPicker, (0 == m_iPly && false == isNullMove(m_rootBest)) ? &m_rootBest : &hash_move);
+
+   int  iBestScore = -INFINITE_SCORE;
+   int  iLegal     = 0;
+   Move best_move;
+   Move move;
+
+   memset(&best_move, 0, sizeof(Move));
+
+   while ( true == nextMove(pPicker, &move) )
+   {
+      bool bQuiet = ( false == isCapture(move) );
+
+      // Killers are returned by their own stage, so a quiet move from the last stage is a "late" one
+      bool bLateQuiet = ( true == bQuiet && STAGE_QUIETS == pPicker->stage );
+
+      if ( false == makeMove(move) )
+      {
+         continue;
+      }
+
+      iLegal++;
+
+      int iScore;
+
+      if ( 1 == iLegal )
+      {
+         // Principal variation search: the first move is searched with the full window...
+         iScore = -alphaBeta(iDepth - 1, -iBeta, -iAlpha);
+      }
+      else
+      {
+         // ...the others only have to prove they are not better (null window).
+         // Late quiet moves are searched even less deep (late move reduction)
+         int iReduction = 0;
+
+         if ( true == m_bUseLmr && iDepth >= 3 && iLegal > 3 && true == bLateQuiet && false == bInCheck && false == inCheck() )
+         {
+            iReduction = (iLegal > 8 && iDepth >= 5) ? 2 : 1;
+         }
+
+         iScore = -alphaBeta(iDepth - 1 - iReduction, -iAlpha - 1, -iAlpha);
+
+         if ( iScore > iAlpha && iReduction > 0 )
+         {
+            iScore = -alphaBeta(iDepth - 1, -iAlpha - 1, -iAlpha);
+         }
+
+         if ( iScore > iAlpha && iScore < iBeta )
+         {
+            iScore = -alphaBeta(iDepth - 1, -iBeta, -iAlpha);
+         }
+      }
+
+      unmakeMove();
+
+      if ( true == m_bStopped )
+      {
+         return 0;
+      }
+
+      if ( iScore > iBestScore )
+      {
+         iBestScore = iScore;
+      }
+
+      if ( iScore > iAlpha )
+      {
+         iAlpha    = iScore;
+         best_move = move;
+
+         // This move leads the principal variation from here on
+         m_pv[m_iPly][0] = move;
+
+         for (int i = 0; i < m_iPvLength[m_iPly + 1]; i++)
+         {
+            m_pv[m_iPly][i + 1] = m_pv[m_iPly + 1][i];
+         }
+
+         m_iPvLength[m_iPly] = m_iPvLength[m_iPly + 1] + 1;
+      }
+
+      if ( iAlpha >= iBeta )
+      {
+         m_stats.iCutoffs++;
+
+         if ( 1 == iLegal )
+         {
+            m_stats.iFirstMoveCutoffs++;
+         }
+
+         if ( true == bQuiet )
+         {
+            updateQuietStats(move, iDepth);
+         }
+         break;
+      }
+   }
+
+   if ( 0 == iLegal )
+   {
+      // Checkmate (the sooner the better) or stalemate
+      return bInCheck ? -MATE_SCORE + m_iPly : 0;
+   }
+
+   int iBound = TranspositionTable::BOUND_UPPER;
+
+   if ( iBestScore >= iBeta )
+   {
+      iBound = TranspositionTable::BOUND_LOWER;
+   }
+   else if ( iBestScore > iAlphaOriginal )
+   {
+      iBound = TranspositionTable::BOUND_EXACT;
+   }
+
+   int iStoredScore = iBestScore;
+
+   if ( iStoredScore >= MATE_SCORE - MAX_PLY )
+   {
+      iStoredScore += m_iPly;
+   }
+   else if ( iStoredScore <= -MATE_SCORE + MAX_PLY )
+   {
+      iStoredScore -= m_iPly;
+   }
+
+   m_tt.store(m_iHashKey, packMove(best_move), iStoredScore, iDepth, iBound);
+
+   return iBestScore;
+}
+
+int Engine::quiesce(int iAlpha, int iBeta)
+{
+   checkLimits();
+
+   if ( true == m_bStopped )
+   {
+      return 0;
+   }
+
+   if ( m_iPly >= MAX_PLY - 1 )
+   {
+      return evaluate();
+   }
+
+   // In check there is no standing pat: every evasion is searched, and having none is a
+   // mate. Otherwise only captures are searched, until the position is quiet
+   bool bInCheck = inCheck();
+   int  iBestScore;
+
+   if ( true == bInCheck )
+   {
+      iBestScore = -MATE_SCORE + m_iPly;
+   }
+   else
+   {
+      iBestScore = evaluate();
+
+      if ( iBestScore >= iBeta )
+      {
+         return iBestScore;
+      }
+
+      if ( iBestScore > iAlpha )
+      {
+         iAlpha = iBestScore;
+      }
+   }
+
+   // Captures that lose material (SEE < 0) are not even tried, unless in check
+   MovePicker* pPicker = &m_picker[m_iPly];
+   initPicker(pPicker, NULL, false == bInCheck);
+
+   Move move;
+
+   while ( true == nextMove(pPicker, &move) )
+   {
+      if ( false == makeMove(move) )
+      {
+         continue;
+      }
+
+      m_stats.iQNodes++;
+
+      int iScore = -quiesce(-iBeta, -iAlpha);
+
+      unmakeMove();
+
+      if ( true == m_bStopped )
+      {
+         return 0;
+      }
+
+      if ( iScore > iBestScore )
+      {
+         iBestScore = iScore;
+      }
+
+      if ( iScore > iAlpha )
+      {
+         iAlpha = iScore;
+      }
+
+      if ( iAlpha >= iBeta )
+      {
+         break;
+      }
+   }
+
+   return iBestScore;
+}
+
+int Engine::evaluate(void)
+{
+   COUNT_CALL(COUNTER_EVALUATE);
+
+   // Material and a few positional hints, from white's point of view
+   int iScore = 0;
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         char chPiece = m_position.getPieceAtPosition(i, j);
+
+         if ( EMPTY_SQUARE == chPiece )
+         {
+            continue;
+         }
+
+         int iIndex = getPieceIndex(chPiece);
+         int iValue = piece_value[iIndex];
+
+         switch (toupper(chPiece))
+         {
+            case 'P':
+            {
+               // Pawns are worth more as they get closer to promotion
+               int iAdvance = isWhitePiece(chPiece) ? i - 1 : 6 - i;
+               iValue += 4 * iAdvance + center_distance[i][j];
+            }
+            break;
+
+            case 'N':
+            {
+               iValue += 4 * center_distance[i][j];
+            }
+            break;
+
+            case 'B':
+            case 'Q':
+            {
+               iValue += 2 * center_distance[i][j];
+            }
+            break;
+
+            case 'K':
+            {
+               // Keep the king away from the center
+               iValue -= 3 * center_distance[i][j];
+            }
+            break;
+         }
+
+         iScore += isWhitePiece(chPiece) ? iValue : -iValue;
+      }
+   }
+
+   return (WHITE_PLAYER == m_position.getCurrentTurn()) ? iScore : -iScore;
+}
+
+bool Engine::sameMove(Move a, Move b)
+{
+   return ( a.from.iRow == b.from.iRow && a.from.iColumn == b.from.iColumn &&
+            a.to.iRow   == b.to.iRow   && a.to.iColumn   == b.to.iColumn   &&
+            a.chPromoted == b.chPromoted );
+}
+
+bool Engine::isNullMove(Move move)
+{
+   return ( move.from.iRow == move.to.iRow && move.from.iColumn == move.to.iColumn );
+}
@@ -0,0 +1,283 @@
+#pragma once
+#include "chess.h"
+#include "tt.h"
+#include "timeman.h"
+
+#include <atomic>
+
+class Engine : Chess
+{
+public:
+   Engine();
+   ~Engine();
+
+   struct Move
+   {
+      Position from;
+      Position to;
+      char     chPromoted; // Piece the pawn becomes, EMPTY_SQUARE if not a promotion
+   };
+
+   enum
+   {
+      MAX_PLY        = 64,
+      MAX_MOVES      = 256,
+      MATE_SCORE     = 30000,
+      INFINITE_SCORE = 32000
+   };
+
+   // What stops the search. Zero means no limit
+   struct Limits
+   {
+      int       iDepth;
+      long long iNodes;
+      int       iMoveTime;     // Milliseconds for this move
+      int       iTime[2];      // Milliseconds left on the clock of each player
+      int       iIncrement[2];
+      int       iMovesToGo;
+      bool      bInfinite;     // Until stop() is called
+      bool      bPonder;       // Thinking on the opponent's time, the clock only starts with ponderhit()
+   };
+
+   // Reported at the end of each iteration
+   struct SearchInfo
+   {
+      int       iDepth;
+      int       iScore;        // Centipawns, from the point of view of the side to move
+      int       iMateIn;       // Moves until mate (negative if being mated), 0 if no mate was found
+      long long iNodes;
+      long long iTime;         // Milliseconds
+      Move      pv[MAX_PLY];
+      int       iPvLength;
+   };
+
+   // Counted during the last search, to tell whether a slow search is due
+   // to the move ordering, the hash table or the evaluation
+   struct SearchStats
+   {
+      long long iNodes;
+      long long iQNodes;                   // Part of iNodes, made in the quiescence search
+      long long iTtProbes;
+      long long iTtHits;
+      long long iCutoffs;                  // Beta cutoffs of the main search
+      long long iFirstMoveCutoffs;         // Of those, caused by the first move tried
+      int       iIterations;               // Completed ones
+      long long iIterationNodes[MAX_PLY];
+      long long iIterationTime[MAX_PLY];   // Milliseconds
+   };
+
+   typedef void (*InfoCallback)( const SearchInfo& info );
+
+   void setPosition( Game& game );
+
+   // The initial position, e.g. setFen(Engine::START_FEN)
+   static const char* const START_FEN;
+
+   bool setFen( string fen );
+
+   string getFen( void );
+
+   bool playMove( string move );
+
+   bool think( int iMaxDepth, Move* pBestMove );
+
+   bool think( const Limits& limits, Move* pBestMove );
+
+   // Before starting think() on another thread, so a stop() sent right after is not lost
+   void prepareSearch( void );
+
+   // These two can be called from another thread while think() is running
+   void stop( void );
+
+   void ponderhit( void );
+
+   void setInfoCallback( InfoCallback pfnCallback );
+
+   void setHashSize( int iMegabytes );
+
+   // Search features that can be switched off, to measure what they are worth.
+   // Returns false if the option does not exist
+   bool setOption( string name, int iValue );
+
+   void clearHash( void );
+
+   long long getNodes( void );
+
+   void getSearchStats( SearchStats* pStats );
+
+   // The statistics as one line of JSON, e.g. {"depth":6,"nodes":123456,"qnodes":45678,...}
+   static string statsToJson( const SearchStats& stats );
+
+   int getPrincipalVariation( Move* pMoves, int iMaxMoves );
+
+   // Finds the legal move written as "e7e8q" or "E7-E8=Q"
+   bool findLegalMove( string text, Move* pMove );
+
+   // All the legal moves in the current position, returns how many
+   int getLegalMoves( Move* pMoves, int iMaxMoves );
+
+   static string moveToString( Move move );
+
+   static string moveToUci( Move move );
+
+   // Plays a move already known to be legal on a Game, logging it the same way makeTheMove() does
+   static void applyMove( Game& game, Move move );
+
+   static int getPieceIndex( char chPiece );
+
+private:
+
+   // Which moves should be generated
+   enum MoveKind
+   {
+      CAPTURES = 0, // Captures and promotions
+      QUIETS,       // Everything else, castling included
+      ALL_MOVES
+   };
+
+   // Stages of the move picker. Quiet moves are only generated
+   // if none of the captures (or the killers) caused a cutoff
+   enum Stage
+   {
+      STAGE_BEST_MOVE = 0,
+      STAGE_GENERATE_CAPTURES,
+      STAGE_CAPTURES,
+      STAGE_KILLERS,
+      STAGE_GENERATE_QUIETS,
+      STAGE_QUIETS,
+      STAGE_BAD_CAPTURES,
+      STAGE_DONE
+   };
+
+   struct ScoredMove
+   {
+      Move move;
+      int  iScore;
+   };
+
+   struct MoveList
+   {
+      ScoredMove moves[MAX_MOVES];
+      int        iCount;
+   };
+
+   struct MovePicker
+   {
+      Stage    stage;
+      bool     bCapturesOnly;
+      Move     best_move;
+      int      iKiller;
+      int      iCurrent;
+      MoveList list;
+
+      // Captures that lose material are only tried after the quiet moves. As many as
+      // there can be moves, so that none is ever dropped
+      Move     bad_captures[MAX_MOVES];
+      int      iNumBadCaptures;
+      int      iCurrentBadCapture;
+   };
+
+   // Everything needed to take a move back
+   struct State
+   {
+      Move     move;
+      char     chMoved;
+      char     chCaptured;
+      Position captured_at;
+      Position en_passant;
+      bool     bCastlingKingSideAllowed[2];
+      bool     bCastlingQueenSideAllowed[2];
+      bool     bNullMove;
+      unsigned long long iHashKey; // Before the move
+   };
+
+   // Move generation
+   void generateMoves( MoveList* pList, MoveKind kind );
+   void generatePieceMoves( Position from, MoveList* pList, MoveKind kind );
+   void addMove( MoveList* pList, Position from, int iRow, int iColumn, MoveKind kind );
+   void addPawnMove( MoveList* pList, Position from, int iRow, int iColumn );
+   void addCastling( MoveList* pList, Position king, int iColor );
+   bool isPseudoLegal( Move move, MoveKind kind );
+
+   // Move ordering
+   void initPicker( MovePicker* pPicker, Move* pBestMove, bool bCapturesOnly = false );
+   bool nextMove( MovePicker* pPicker, Move* pMove );
+   bool pickBest( MovePicker* pPicker, Move* pMove );
+   bool isCapture( Move move );
+   int  see( Move move );
+   void updateQuietStats( Move move, int iDepth );
+
+   // Make and unmake moves on the internal position
+   bool makeMove( Move move );
+   void unmakeMove( void );
+   void makeNullMove( void );
+   void unmakeNullMove( void );
+   bool inCheck( void );
+   bool hasNonPawnMaterial( int iColor );
+
+   void initPosition( void );
+
+   // Hashing
+   unsigned long long computeHashKey( void );
+   int  getCastlingRights( void );
+   bool isRepetition( void );
+   unsigned short packMove( Move move );
+   Move unpackMove( unsigned short iMove );
+   void checkLimits( void );
+
+   // Search
+   int  alphaBeta( int iDepth, int iAlpha, int iBeta );
+   int  quiesce( int iAlpha, int iBeta );
+   int  evaluate( void );
+
+   static bool sameMove( Move a, Move b );
+   static bool isNullMove( Move move );
+
+   // The position being searched
+   Game      m_position;
+   Position  m_EnPassant; // Square a pawn can move to capturing "en passant", iRow is -1 if none
+   Position  m_King[2];
+   int       m_iMaterial[2][6]; // How many pieces of each kind, indexed by getPieceIndex()
+
+   // Hash key of the position and of the ones played before the search started
+   unsigned long long              m_iHashKey;
+   std::vector<unsigned long long> m_gameKeys;
+   TranspositionTable              m_tt;
+   int                             m_iHashSize;
+
+   // Options
+   bool m_bUseNullMove;
+   bool m_bUseLmr;
+
+   State      m_state[MAX_PLY];
+   MovePicker m_picker[MAX_PLY];
+   int        m_iPly;
+
+   // Move ordering heuristics
+   Move m_killers[MAX_PLY][2];
+   int  m_history[2][64][64];
+
+   // Principal variation, collected for each ply
+   Move m_pv[MAX_PLY][MAX_PLY];
+   int  m_iPvLength[MAX_PLY];
+
+   // Best line of the last completed iteration
+   Move m_bestPv[MAX_PLY];
+   int  m_iBestPvLength;
+
+   Move        m_rootBest;
+   long long   m_iNodes;
+   SearchStats m_stats;
+
+   // Limits of the current search
+   Limits       m_limits;
+   TimeManager  m_time;
+   int          m_iCheckCountdown;
+   bool         m_bStopped;
+   bool         m_bPondering;
+   InfoCallback m_pfnInfo;
+
+   // Requests from other threads, handled in checkLimits()
+   std::atomic<bool> m_bStopRequested;
+   std::atomic<bool> m_bPonderHit;
+};
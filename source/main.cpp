@@ -2,395 +2,101 @@
 
 #include "user_interface.h"
 #include "chess.h"
+#include "engine.h"
+#include "uci.h"
+#include "search_bench.h"
+#include "terminal.h"
+#include "server.h"
 
 #include "debug.h"
 
+#include <thread>
+#include <sstream>
+#include <map>
+#include <csignal>
+
 
 //---------------------------------------------------------------------------------------
 // Global variable
 //---------------------------------------------------------------------------------------
 Game* current_game = NULL;
+Engine* current_engine = NULL;
 
 
 //---------------------------------------------------------------------------------------
-// Helper
-// Auxiliar functions to determine if a move is valid, etc
+// Engine
+// How deep the computer searches when it is asked to move
 //---------------------------------------------------------------------------------------
-bool isMoveValid(Chess::Position present, Chess::Position future, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion)
-{
-   bool bValid = false;
-
-   char chPiece = current_game->getPieceAtPosition(present.iRow, present.iColumn);
-
-   // ----------------------------------------------------
-   // 1. Is the piece  allowed to move in that direction?
-   // ----------------------------------------------------
-   switch( toupper(chPiece) )
-   {
-      case 'P':
-      {
-         // Wants to move forward
-         if ( future.iColumn == present.iColumn )
-         {
-            // Simple move forward
-            if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 1) ||
-                 (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 1) )
-            {
-               if ( EMPTY_SQUARE == current_game->getPieceAtPosition(future.iRow, future.iColumn) )
-               {
-                  bValid = true;
-               }
-            }
-
-            // Double move forward
-            else if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 2) ||
-                      (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 2) )
-            {
-               // This is only allowed if the pawn is in its original place
-               if ( Chess::isWhitePiece(chPiece) )
-               {
-                  if ( EMPTY_SQUARE == current_game->getPieceAtPosition(future.iRow-1, future.iColumn) &&
-                       EMPTY_SQUARE == current_game->getPieceAtPosition(future.iRow, future.iColumn)   &&
-                                1   == present.iRow )
-                  {
-                     bValid = true;
-                  }
-               }
-               else // if ( isBlackPiece(chPiece) )
-               {
-                  if ( EMPTY_SQUARE == current_game->getPieceAtPosition(future.iRow + 1, future.iColumn) &&
-                       EMPTY_SQUARE == current_game->getPieceAtPosition(future.iRow, future.iColumn)     &&
-                                6   == present.iRow)
-                  {
-                     bValid = true;
-                  }
-               }
-            }
-            else
-            {
-               // This is invalid
-               return false;
-            }
-         }
-         
-         // The "en passant" move
-         else if ( (Chess::isWhitePiece(chPiece) && 4 == present.iRow && 5 == future.iRow && 1 == abs(future.iColumn - present.iColumn) ) ||
-                   (Chess::isBlackPiece(chPiece) && 3 == present.iRow && 2 == future.iRow && 1 == abs(future.iColumn - present.iColumn) ) )
-         {
-            // It is only valid if last move of the opponent was a double move forward by a pawn on a adjacent column
-            string last_move = current_game->getLastMove();
-
-            // Parse the line
-            Chess::Position LastMoveFrom;
-            Chess::Position LastMoveTo;
-            current_game->parseMove(last_move, &LastMoveFrom, &LastMoveTo);
-
-            // First of all, was it a pawn?
-            char chLstMvPiece = current_game->getPieceAtPosition(LastMoveTo.iRow, LastMoveTo.iColumn);
-
-            if (toupper(chLstMvPiece) != 'P')
-            {
-               return false;
-            }
-
-            // Did the pawn have a double move forward and was it an adjacent column?
-            if ( 2 == abs(LastMoveTo.iRow - LastMoveFrom.iRow) && 1 == abs(LastMoveFrom.iColumn - present.iColumn) )
-            {
-               cout << "En passant move!\n";
-               bValid = true;
+#define ENGINE_DEPTH 6
 
-               S_enPassant->bApplied = true;
-               S_enPassant->PawnCaptured.iRow    = LastMoveTo.iRow;
-               S_enPassant->PawnCaptured.iColumn = LastMoveTo.iColumn;
-            }
-         }
+// With --stats, the statistics of each search are shown as a JSON line after the computer moves
+bool bShowSearchStats = false;
 
-         // Wants to capture a piece
-         else if (1 == abs(future.iColumn - present.iColumn))
-         {
-            if ( (Chess::isWhitePiece(chPiece) && future.iRow == present.iRow + 1) || (Chess::isBlackPiece(chPiece) && future.iRow == present.iRow - 1))
-            {
-               // Only allowed if there is something to be captured in the square
-               if (EMPTY_SQUARE != current_game->getPieceAtPosition(future.iRow, future.iColumn))
-               {
-                  bValid = true;
-                  cout << "Pawn captured a piece!\n";
-               }
-            }
-         }
-         else
-         {
-            // This is invalid
-            return false;
-         }
 
-         // If a pawn reaches its eight rank, it must be promoted to another piece
-         if ( (Chess::isWhitePiece( chPiece ) && 7 == future.iRow) ||
-              (Chess::isBlackPiece( chPiece ) && 0 == future.iRow) )
-         {
-            cout << "Pawn must be promoted!\n";
-            S_promotion->bApplied = true;
-         }
-      }
-      break;
+//---------------------------------------------------------------------------------------
+// Pondering
+// While the user is thinking, the engine searches the position after the move it
+// expects the user to play. If the user plays it, the answer is (almost) ready
+//---------------------------------------------------------------------------------------
+std::thread  ponder_thread;
+Engine::Move ponder_move;          // Move we expect from the user
+Engine::Move ponder_reply;         // Best answer to it, when the search is over
+bool         bPonderFound = false;
+int          iPonderHalfMoves = 0; // Number of moves played when pondering started
+bool         bAllowPondering = true;  // Not with --script, nobody is thinking between the commands
 
-      case 'R':
-      {
-         // Horizontal move
-         if ( (future.iRow == present.iRow) && (future.iColumn != present.iColumn) )
-         {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::HORIZONTAL) )
-            {
-               bValid = true;
-            }
-         }
-         // Vertical move
-         else if ( (future.iRow != present.iRow) && (future.iColumn == present.iColumn) )
-         {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::VERTICAL) )
-            {
-               bValid = true;
-            }
-         }
-      }
-      break;
+// The computer's own search runs on search_thread too, like the one of --uci, so that it can
+// be stopped: Ctrl+C while the computer thinks plays the best move found so far
+std::thread  search_thread;
+Engine::Move search_reply;
+bool         bSearchFound = false;
 
-      case 'N':
-      {
-         if ( (2 == abs(future.iRow - present.iRow)) && (1 == abs(future.iColumn - present.iColumn)) )
-         {
-            bValid = true;
-         }
 
-         else if (( 1 == abs(future.iRow - present.iRow)) && (2 == abs(future.iColumn - present.iColumn)) )
-         {
-            bValid = true;
-         }
-      }
-      break;
+//---------------------------------------------------------------------------------------
+// Helper
+// Auxiliar functions to show what a move did, etc. The rules themselves are in Game
+//---------------------------------------------------------------------------------------
+void playTheMove(Chess::Position present, Chess::Position future, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion)
+{
+   // Captures and castling are told to the user, other moves leave the message as it is
+   string description = current_game->makeTheMove(present, future, S_enPassant, S_castling, S_promotion);
 
-      case 'B':
-      {
-         // Diagonal move
-         if ( abs(future.iRow - present.iRow) == abs(future.iColumn - present.iColumn) )
-         {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::DIAGONAL) )
-            {
-               bValid = true;
-            }
-         }
-      }
-      break;
+   if ( false == description.empty() )
+   {
+      createNextMessage(description);
+   }
+}
 
-      case 'Q':
+void announceCheck(void)
+{
+   // Keep in mind that player turn has already changed
+   if ( true == current_game->playerKingInCheck() )
+   {
+      if (true == current_game->isCheckMate() )
       {
-         // Horizontal move
-         if ( (future.iRow == present.iRow) && (future.iColumn != present.iColumn) )
-         {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::HORIZONTAL))
-            {
-               bValid = true;
-            }
-         }
-         // Vertical move
-         else if ( (future.iRow != present.iRow) && (future.iColumn == present.iColumn) )
+         if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
          {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::VERTICAL))
-            {
-               bValid = true;
-            }
+            appendToNextMessage("Checkmate! Black wins the game!\n");
          }
-
-         // Diagonal move
-         else if ( abs(future.iRow - present.iRow) == abs(future.iColumn - present.iColumn) )
+         else
          {
-            // Check if there are no pieces on the way
-            if ( current_game->isPathFree(present, future, Chess::DIAGONAL))
-            {
-               bValid = true;
-            }
+            appendToNextMessage("Checkmate! White wins the game!\n");
          }
       }
-      break;
-
-      case 'K':
-      {
-         // Horizontal move by 1
-         if ( (future.iRow == present.iRow) && (1 == abs(future.iColumn - present.iColumn) ) )
-         {
-            bValid = true;
-         }
-
-         // Vertical move by 1
-         else if ( (future.iColumn == present.iColumn) && (1 == abs(future.iRow - present.iRow) ) )
-         {
-            bValid = true;
-         }
-
-         // Diagonal move by 1
-         else if ( (1 == abs(future.iRow - present.iRow) ) && (1 == abs(future.iColumn - present.iColumn) ) )
+      else
+      { 
+         // Add to the string with '+=' because it's possible that
+         // there is already one message (e.g., piece captured)
+         if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
          {
-            bValid = true;
+            appendToNextMessage("White king is in check!\n");
          }
-
-         // Castling
-         else if ( (future.iRow == present.iRow) && (2 == abs(future.iColumn - present.iColumn) ) )
+         else
          {
-            // Castling is only allowed in these circunstances:
-
-            // 1. King is not in check
-            if ( true == current_game->playerKingInCheck() )
-            {
-               return false;
-            }
-
-            // 2. No pieces in between the king and the rook
-            if ( false == current_game->isPathFree( present, future, Chess::HORIZONTAL ) )
-            {
-               return false;
-            }
-
-            // 3. King and rook must not have moved yet;
-            // 4. King must not pass through a square that is attacked by an enemy piece
-            if ( future.iColumn > present.iColumn )
-            {
-               // if future.iColumn is greather, it means king side
-               if ( false == current_game->castlingAllowed(Chess::Side::KING_SIDE, Chess::getPieceColor(chPiece) ) )
-               {
-                  createNextMessage("Castling to the king side is not allowed.\n");
-                  return false;
-               }
-               else
-               {
-                  // Check if the square that the king skips is not under attack
-                  Chess::UnderAttack square_skipped = current_game->isUnderAttack( present.iRow, present.iColumn + 1, current_game->getCurrentTurn() );
-                  if ( false == square_skipped.bUnderAttack )
-                  {
-                     // Fill the S_castling structure
-                     S_castling->bApplied = true;
-
-                     // Present position of the rook
-                     S_castling->rook_before.iRow    = present.iRow;
-                     S_castling->rook_before.iColumn = present.iColumn + 3;
-
-                     // Future position of the rook
-                     S_castling->rook_after.iRow    = future.iRow;
-                     S_castling->rook_after.iColumn = present.iColumn + 1; // future.iColumn -1
-
-                     bValid = true;
-                  }
-               }
-            }
-            else //if (future.iColumn < present.iColumn)
-            {
-               // if present.iColumn is greather, it means queen side
-               if (false == current_game->castlingAllowed(Chess::Side::QUEEN_SIDE, Chess::getPieceColor(chPiece)))
-               {
-                  createNextMessage("Castling to the queen side is not allowed.\n");
-                  return false;
-               }
-               else
-               {
-                  // Check if the square that the king skips is not attacked
-                  Chess::UnderAttack square_skipped = current_game->isUnderAttack( present.iRow, present.iColumn - 1, current_game->getCurrentTurn() );
-                  if ( false == square_skipped.bUnderAttack )
-                  {
-                     // Fill the S_castling structure
-                     S_castling->bApplied = true;
-
-                     // Present position of the rook
-                     S_castling->rook_before.iRow    = present.iRow;
-                     S_castling->rook_before.iColumn = present.iColumn - 4;
-
-                     // Future position of the rook
-                     S_castling->rook_after.iRow    = future.iRow;
-                     S_castling->rook_after.iColumn = present.iColumn - 1; // future.iColumn +1
-
-                     bValid = true;
-                  }
-               }
-            }
+            appendToNextMessage("Black king is in check!\n");
          }
       }
-      break;
-
-      default:
-      {
-         cout << "!!!!Should not reach here. Invalid piece: " << char(chPiece) << "\n\n\n";
-      }
-      break;
-   }
-
-   // If it is a move in an invalid direction, do not even bother to check the rest
-   if ( false == bValid )
-   {
-      cout << "Piece is not allowed to move to that square\n";
-      return false;
-   }
-
-
-   // -------------------------------------------------------------------------
-   // 2. Is there another piece of the same color on the destination square?
-   // -------------------------------------------------------------------------
-   if (current_game->isSquareOccupied(future.iRow, future.iColumn))
-   {
-      char chAuxPiece = current_game->getPieceAtPosition(future.iRow, future.iColumn);
-      if ( Chess::getPieceColor(chPiece) == Chess::getPieceColor(chAuxPiece) )
-      {
-         cout << "Position is already taken by a piece of the same color\n";
-         return false;
-      }
-   }
-
-   // ----------------------------------------------
-   // 3. Would the king be in check after the move?
-   // ----------------------------------------------
-   if ( true == current_game->wouldKingBeInCheck(chPiece, present, future, S_enPassant) )
-   {
-      cout << "Move would put player's king in check\n";
-      return false;
-   }
-
-   return bValid;
-}
-
-void makeTheMove(Chess::Position present, Chess::Position future, Chess::EnPassant* S_enPassant, Chess::Castling* S_castling, Chess::Promotion* S_promotion)
-{
-   char chPiece = current_game->getPieceAtPosition(present.iRow, present.iColumn);
-
-   // -----------------------
-   // Captured a piece?
-   // -----------------------
-   if ( current_game->isSquareOccupied(future.iRow, future.iColumn) )
-   {
-      char chAuxPiece = current_game->getPieceAtPosition(future.iRow, future.iColumn);
-
-      if ( Chess::getPieceColor(chPiece) != Chess::getPieceColor(chAuxPiece))
-      {
-         createNextMessage(Chess::describePiece(chAuxPiece) + " captured!\n");
-      }
-      else
-      {
-         cout << "Error. We should not be making this move\n";
-         throw("Error. We should not be making this move");
-      }
-   }
-   else if (true == S_enPassant->bApplied)
-   {
-      createNextMessage("Pawn captured by \"en passant\" move!\n");
    }
-
-   if ( (true == S_castling->bApplied) )
-   {
-      createNextMessage("Castling applied!\n");
-   }
-
-   current_game->movePiece(present, future, S_enPassant, S_castling, S_promotion);
 }
 
 //---------------------------------------------------------------------------------------
@@ -422,8 +128,6 @@ void undoMove(void)
 
 void movePiece(void)
 {
-   std::string to_record;
-
    // Get user input for the piece they want to move
    cout << "Choose piece to be moved. (example: A1 or b2): ";
 
@@ -461,11 +165,6 @@ void movePiece(void)
       return;
    }
 
-   // Put in the string to be logged
-   to_record += present.iColumn;
-   to_record += present.iRow;
-   to_record += "-";
-
    // Convert column from ['A'-'H'] to [0x00-0x07]
    present.iColumn = present.iColumn - 'A';
 
@@ -535,10 +234,6 @@ void movePiece(void)
       return;
    }
 
-   // Put in the string to be logged
-   to_record += future.iColumn;
-   to_record += future.iRow;
-
    // Convert columns from ['A'-'H'] to [0x00-0x07]
    future.iColumn = future.iColumn - 'A';
 
@@ -557,7 +252,7 @@ void movePiece(void)
    Chess::Castling   S_castling   = { 0 };
    Chess::Promotion  S_promotion  = { 0 };
 
-   if ( false == isMoveValid(present, future, &S_enPassant, &S_castling, &S_promotion) )
+   if ( false == current_game->isMoveValid(present, future, &S_enPassant, &S_castling, &S_promotion) )
    {
       createNextMessage("[Invalid] Piece can not move to that square!\n");
       return;
@@ -597,96 +292,360 @@ void movePiece(void)
       {
          S_promotion.chAfter = tolower(chPromoted);
       }
-
-      to_record += '=';
-      to_record += toupper(chPromoted); // always log with a capital letter
    }
 
    // ---------------------------------------------------
    // Log the move: do it prior to making the move
-   // because we need the getCurrentTurn()
    // ---------------------------------------------------
-   current_game->logMove( to_record );
+   current_game->logMove( present, future, (true == S_promotion.bApplied) ? S_promotion.chAfter : EMPTY_SQUARE );
 
    // ---------------------------------------------------
    // Make the move
    // ---------------------------------------------------
-   makeTheMove(present, future, &S_enPassant, &S_castling, &S_promotion);
+   playTheMove(present, future, &S_enPassant, &S_castling, &S_promotion);
 
    // ---------------------------------------------------------------
    // Check if this move we just did put the oponent's king in check
    // Keep in mind that player turn has already changed
    // ---------------------------------------------------------------
-   if ( true == current_game->playerKingInCheck() )
-   {
-      if (true == current_game->isCheckMate() )
-      {
-         if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
-         {
-            appendToNextMessage("Checkmate! Black wins the game!\n");
-         }
-         else
-         {
-            appendToNextMessage("Checkmate! White wins the game!\n");
-         }
-      }
-      else
-      { 
-         // Add to the string with '+=' because it's possible that
-         // there is already one message (e.g., piece captured)
-         if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
-         {
-            appendToNextMessage("White king is in check!\n");
-         }
-         else
-         {
-            appendToNextMessage("Black king is in check!\n");
-         }
-      }
-   }
+   announceCheck();
 
    return;
 }
 
-void saveGame(void)
+int countHalfMoves(void)
 {
-   string file_name;
-   cout << "Type file name to be saved (no extension): ";
+   return current_game->getNumHalfMoves();
+}
 
-   getline(cin, file_name);
-   file_name += ".dat";
+void ponderSearch(void)
+{
+   // Runs on ponder_thread, until stopPondering() or a ponder hit
+   Engine::Limits limits;
+   memset(&limits, 0, sizeof(Engine::Limits));
 
-   std::ofstream ofs(file_name);
-   if (ofs.is_open())
-   {
-      // Write the date and time of save operation
-      auto time_now = std::chrono::system_clock::now();
-      std::time_t end_time = std::chrono::system_clock::to_time_t(time_now);
-      ofs << "[Chess console] Saved at: " << std::ctime(&end_time);
+   limits.iDepth  = ENGINE_DEPTH;
+   limits.bPonder = true;
 
-      // Write the moves
-      for (unsigned i = 0; i < current_game->rounds.size(); i++)
-      {
-         ofs << current_game->rounds[i].white_move.c_str() << " | " << current_game->rounds[i].black_move.c_str() << "\n";
-      }
+   bPonderFound = current_engine->think(limits, &ponder_reply);
+}
 
-      ofs.close();
-      createNextMessage("Game saved as " + file_name + "\n");
-   }
-   else
+void startPondering(void)
+{
+   // The second move of the principal variation is the user's expected reply
+   Engine::Move pv[2];
+
+   if ( 2 != current_engine->getPrincipalVariation(pv, 2) )
    {
-      cout << "Error creating file! Save failed\n";
+      return;
    }
 
-   return;
-}
+   ponder_move      = pv[1];
+   iPonderHalfMoves = countHalfMoves();
 
-void loadGame(void)
+   current_engine->setPosition(*current_game);
+
+   if ( false == current_engine->playMove(Engine::moveToUci(ponder_move)) )
+   {
+      return;
+   }
+
+   current_engine->prepareSearch();
+   ponder_thread = std::thread(ponderSearch);
+}
+
+void stopPondering(void)
+{
+   if ( true == ponder_thread.joinable() )
+   {
+      current_engine->stop();
+      ponder_thread.join();
+   }
+}
+
+void computerSearch(void)
+{
+   // Runs on search_thread, until the depth is reached or Ctrl+C
+   bSearchFound = current_engine->think(ENGINE_DEPTH, &search_reply);
+}
+
+void onInterrupt(int)
+{
+   // Only sets a flag the search looks at
+   current_engine->stop();
+}
+
+void waitForSearch(std::thread& search)
+{
+   // Ctrl+C only stops the search while the computer is thinking. Any other time it still ends the program
+   void (*pfnPrevious)(int) = std::signal(SIGINT, onInterrupt);
+
+   if ( true == terminalIsInteractive() )
+   {
+      cout << "Thinking... Ctrl+C to play now" << endl;
+   }
+
+   search.join();
+
+   std::signal(SIGINT, pfnPrevious);
+}
+
+bool isPonderHit(void)
+{
+   // Exactly one move was played since the computer moved, and it was the one we expected
+   if ( false == ponder_thread.joinable() || countHalfMoves() != iPonderHalfMoves + 1 )
+   {
+      return false;
+   }
+
+   Chess::Position from;
+   Chess::Position to;
+   char            chPromoted;
+
+   if ( false == current_game->getLastMove(&from, &to, &chPromoted) )
+   {
+      return false;
+   }
+
+   return ( from.iRow    == ponder_move.from.iRow    && from.iColumn == ponder_move.from.iColumn &&
+            to.iRow      == ponder_move.to.iRow      && to.iColumn   == ponder_move.to.iColumn   &&
+            toupper(chPromoted) == toupper(ponder_move.chPromoted) );
+}
+
+void computerMove(void)
+{
+   if (NULL == current_engine)
+   {
+      current_engine = new Engine();
+   }
+
+   Engine::Move best_move;
+   bool         bFound;
+
+   if ( true == isPonderHit() )
+   {
+      // ---------------------------------------------------
+      // The engine is already searching this position:
+      // let it finish, keeping everything it found so far
+      // ---------------------------------------------------
+      current_engine->ponderhit();
+      waitForSearch(ponder_thread);
+
+      best_move = ponder_reply;
+      bFound    = bPonderFound;
+   }
+   else
+   {
+      stopPondering();
+
+      // ---------------------------------------------------
+      // Let the engine search the current position
+      // ---------------------------------------------------
+      current_engine->setPosition(*current_game);
+      current_engine->prepareSearch();
+
+      search_thread = std::thread(computerSearch);
+      waitForSearch(search_thread);
+
+      best_move = search_reply;
+      bFound    = bSearchFound;
+   }
+
+   if ( false == bFound )
+   {
+      createNextMessage("The computer has no legal moves!\n");
+      return;
+   }
+
+   // ---------------------------------------------------
+   // The move goes through the same rules as the user's
+   // ---------------------------------------------------
+   Chess::EnPassant  S_enPassant  = { 0 };
+   Chess::Castling   S_castling   = { 0 };
+   Chess::Promotion  S_promotion  = { 0 };
+
+   if ( false == current_game->isMoveValid(best_move.from, best_move.to, &S_enPassant, &S_castling, &S_promotion) )
+   {
+      createNextMessage("[Invalid] The computer tried an invalid move!\n");
+      return;
+   }
+
+   if ( S_promotion.bApplied == true )
+   {
+      S_promotion.chBefore = current_game->getPieceAtPosition(best_move.from.iRow, best_move.from.iColumn);
+      S_promotion.chAfter  = best_move.chPromoted;
+   }
+
+   createNextMessage("Computer played " + Engine::moveToString(best_move) + "\n");
+
+   if ( true == bShowSearchStats )
+   {
+      Engine::SearchStats stats;
+      current_engine->getSearchStats(&stats);
+
+      appendToNextMessage(Engine::statsToJson(stats) + "\n");
+   }
+
+   current_game->logMove( best_move.from, best_move.to, best_move.chPromoted );
+
+   playTheMove(best_move.from, best_move.to, &S_enPassant, &S_castling, &S_promotion);
+
+   announceCheck();
+
+   // Think on the user's time
+   if ( true == bAllowPondering && false == current_game->isFinished() )
+   {
+      startPondering();
+   }
+}
+
+bool saveGameAs(string file_name)
+{
+   file_name += ".dat";
+
+   std::ofstream ofs(file_name);
+   if (ofs.is_open())
+   {
+      // Write the date and time of save operation
+      auto time_now = std::chrono::system_clock::now();
+      std::time_t end_time = std::chrono::system_clock::to_time_t(time_now);
+      ofs << "[Chess console] Saved at: " << std::ctime(&end_time);
+
+      // Write the moves
+      for (int i = 0; i < current_game->getNumRounds(); i++)
+      {
+         ofs << current_game->getRoundText(i) << "\n";
+      }
+
+      ofs.close();
+      createNextMessage("Game saved as " + file_name + "\n");
+
+      return true;
+   }
+
+   return false;
+}
+
+void saveGame(void)
 {
    string file_name;
-   cout << "Type file name to be loaded (no extension): ";
+   cout << "Type file name to be saved (no extension): ";
 
    getline(cin, file_name);
+
+   if ( false == saveGameAs(file_name) )
+   {
+      cout << "Error creating file! Save failed\n";
+   }
+
+   return;
+}
+
+bool playMoveText(string text, string* pError)
+{
+   // Plays one move written as in the saved games ("E2-E4", "E7-E8=Q") on current_game,
+   // through the same rules as the user's moves. If it can't be played, the reason is in *pError
+   Chess::Position from;
+   Chess::Position to;
+
+   char chPromoted = 0;
+
+   current_game->parseMove(text, &from, &to, &chPromoted);
+
+   // Check if line is valid
+   if ( from.iColumn < 0 || from.iColumn > 7 ||
+        from.iRow    < 0 || from.iRow    > 7 ||
+        to.iColumn   < 0 || to.iColumn   > 7 ||
+        to.iRow      < 0 || to.iRow      > 7 )
+   {
+      *pError = "there are invalid lines";
+      return false;
+   }
+
+   // Is that move allowed? (should be because we already validated before saving)
+   Chess::EnPassant S_enPassant = { 0 };
+   Chess::Castling  S_castling  = { 0 };
+   Chess::Promotion S_promotion = { 0 };
+
+   if ( false == current_game->isMoveValid(from, to, &S_enPassant, &S_castling, &S_promotion) )
+   {
+      *pError = "there are invalid moves";
+      return false;
+   }
+
+   // ---------------------------------------------------
+   // A promotion occurred
+   // ---------------------------------------------------
+   if ( S_promotion.bApplied == true )
+   {
+      if ( chPromoted != 'Q' && chPromoted != 'R' && chPromoted != 'N' && chPromoted != 'B' )
+      {
+         *pError = "there is an invalid promotion";
+         return false;
+      }
+
+      S_promotion.chBefore = current_game->getPieceAtPosition(from.iRow, from.iColumn);
+
+      if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
+      {
+         S_promotion.chAfter = toupper(chPromoted);
+      }
+      else
+      {
+         S_promotion.chAfter = tolower(chPromoted);
+      }
+   }
+
+
+   // Log the move
+   current_game->logMove(from, to, (true == S_promotion.bApplied) ? S_promotion.chAfter : EMPTY_SQUARE);
+
+   // Make the move
+   playTheMove(from, to, &S_enPassant, &S_castling, &S_promotion);
+
+   return true;
+}
+
+bool playSavedMoves(std::istream& is, string* pError)
+{
+   // Plays the moves of a saved game on current_game, through the same rules as the user's moves.
+   // Stops at the first line that can't be played, with the reason in *pError
+   std::string line;
+
+   while (std::getline(is, line) )
+   {
+      // Skip lines that starts with "[]"
+      if ( 0 == line.compare(0, 1, "["))
+      {
+         continue;
+      }
+
+      // There might be one or two moves in the line
+      string loaded_move[2];
+      
+      // Find the separator and subtract one
+      std::size_t separator = line.find(" |");
+
+      // For the first move, read from the beginning of the string until the separator
+      loaded_move[0] = line.substr(0, separator);
+
+      // For the second move, read from the separator until the end of the string (omit second parameter)
+      loaded_move[1] = line.substr(line.find("|") + 2);
+
+      for (int i = 0; i < 2 && loaded_move[i] != ""; i++)
+      {
+         if ( false == playMoveText(loaded_move[i], pError) )
+         {
+            return false;
+         }
+      }
+   }
+
+   return true;
+}
+
+bool loadGameFrom(string file_name)
+{
    file_name += ".dat";
 
    std::ifstream ifs(file_name);
@@ -702,115 +661,591 @@ void loadGame(void)
       current_game = new Game();
 
       // Now, read the lines from the file and then make the moves
-      std::string line;
+      string error;
 
-      while (std::getline(ifs, line) )
+      if ( false == playSavedMoves(ifs, &error) )
       {
-         // Skip lines that starts with "[]"
-         if ( 0 == line.compare(0, 1, "["))
+         createNextMessage("[Invalid] Can't load this game because " + error + "!\n");
+
+         // Clear everything and return
+         current_game = new Game();
+         return false;
+      }
+
+      // Extra line after the user input
+      createNextMessage("Game loaded from " + file_name + "\n");
+
+      return true;
+   }
+   else
+   {
+      createNextMessage("Error loading " + file_name + ". Creating a new game instead\n");
+      current_game = new Game();
+      return false;
+   }
+}
+
+void loadGame(void)
+{
+   string file_name;
+   cout << "Type file name to be loaded (no extension): ";
+
+   getline(cin, file_name);
+
+   loadGameFrom(file_name);
+}
+
+//---------------------------------------------------------------------------------------
+// Replay
+// Replays saved games through the rules, checks that each one ends where it should and
+// times it. The expected end is written in the file itself, in a line loadGame() skips:
+//
+//    [Expected] <first four fields of the FEN> <playing | check | checkmate | invalid>
+//
+// The time of each file can be compared to a baseline saved before, and the replay
+// fails if one of them got slower than the threshold allows.
+//
+// Usage: chess_console replay [--repeat N] [--baseline file] [--update-baseline]
+//                             [--threshold percent] file.dat...
+// Returns 0 if everything passed, 1 otherwise
+//---------------------------------------------------------------------------------------
+class NullBuffer : public std::streambuf
+{
+protected:
+   int overflow( int iChar ) { return iChar; }
+};
+
+string describeFinalState(bool bLoaded)
+{
+   // Same format as the [Expected] line
+   if ( false == bLoaded )
+   {
+      return "invalid";
+   }
+
+   // Only the pieces, turn, castling rights and "en passant" square: move counters are not kept by Game
+   std::istringstream iss(current_game->getFen());
+   string field;
+   string state;
+
+   for (int i = 0; i < 4 && iss >> field; i++)
+   {
+      state += field + " ";
+   }
+
+   if ( true == current_game->isCheckMate() )
+   {
+      state += "checkmate";
+   }
+   else if ( true == current_game->playerKingInCheck() )
+   {
+      state += "check";
+   }
+   else
+   {
+      state += "playing";
+   }
+
+   return state;
+}
+
+bool replayOnce(const string& contents, string* pState)
+{
+   if (NULL != current_game)
+   {
+      delete current_game;
+   }
+
+   current_game = new Game();
+
+   std::istringstream iss(contents);
+   string error;
+
+   bool bLoaded = playSavedMoves(iss, &error);
+
+   if ( NULL != pState )
+   {
+      *pState = describeFinalState(bLoaded);
+   }
+
+   return bLoaded;
+}
+
+int replayGames(int argc, char* argv[])
+{
+   // argv[0] is "replay"
+   int    iRepeat    = 200;
+   int    iThreshold = 25;
+   bool   bUpdate    = false;
+   string baseline_file;
+   std::vector<string> files;
+
+   for (int i = 1; i < argc; i++)
+   {
+      string arg = argv[i];
+
+      if ( "--repeat" == arg && i + 1 < argc )
+      {
+         iRepeat = max(1, atoi(argv[++i]));
+      }
+      else if ( "--baseline" == arg && i + 1 < argc )
+      {
+         baseline_file = argv[++i];
+      }
+      else if ( "--threshold" == arg && i + 1 < argc )
+      {
+         iThreshold = atoi(argv[++i]);
+      }
+      else if ( "--update-baseline" == arg )
+      {
+         bUpdate = true;
+      }
+      else
+      {
+         files.push_back(arg);
+      }
+   }
+
+   if ( files.empty() )
+   {
+      cout << "Usage: chess_console replay [--repeat N] [--baseline file] [--update-baseline] [--threshold percent] file.dat...\n";
+      return 1;
+   }
+
+   // Microseconds per replay of each file, from a previous run
+   std::map<string, double> baseline;
+
+   if ( false == baseline_file.empty() && false == bUpdate )
+   {
+      std::ifstream ifs(baseline_file);
+      string name;
+      double dTime;
+
+      while ( ifs >> name >> dTime )
+      {
+         baseline[name] = dTime;
+      }
+   }
+
+   std::map<string, double> times;
+   int iFailed = 0;
+
+   // Every replay is a new Game: they all reuse the same few blocks of this pool
+   SlabPool  pool;
+   PoolScope scope(&pool);
+
+   // Whatever the rules print while replaying goes nowhere
+   NullBuffer      null_buffer;
+   std::streambuf* pConsole = cout.rdbuf();
+
+   for (unsigned f = 0; f < files.size(); f++)
+   {
+      string name = files[f].substr(files[f].find_last_of("/\\") + 1);
+
+      std::ifstream ifs(files[f]);
+
+      if ( false == ifs.is_open() )
+      {
+         cout << "FAIL " << name << ": can't be opened\n";
+         iFailed++;
+         continue;
+      }
+
+      std::stringstream contents;
+      contents << ifs.rdbuf();
+
+      // The expected end of the game
+      string expected;
+      string line;
+
+      while ( std::getline(contents, line) )
+      {
+         if ( 0 == line.compare(0, 11, "[Expected] ") )
          {
-            continue;
+            expected = line.substr(11);
          }
+      }
+
+      // First the result, then the time. The best of five rounds is kept, the others had more noise
+      string state;
+
+      cout.rdbuf(&null_buffer);
 
-         // There might be one or two moves in the line
-         string loaded_move[2];
-         
-         // Find the separator and subtract one
-         std::size_t separator = line.find(" |");
+      replayOnce(contents.str(), &state);
 
-         // For the first move, read from the beginning of the string until the separator
-         loaded_move[0] = line.substr(0, separator);
+      double dBest = 0;
 
-         // For the second move, read from the separator until the end of the string (omit second parameter)
-         loaded_move[1] = line.substr(line.find("|") + 2);
+      for (int iRound = 0; iRound < 5; iRound++)
+      {
+         auto tStart = std::chrono::steady_clock::now();
 
-         for (int i = 0; i < 2 && loaded_move[i] != ""; i++)
+         for (int i = 0; i < iRepeat; i++)
          {
-            // Parse the line
-            Chess::Position from;
-            Chess::Position to;
+            replayOnce(contents.str(), NULL);
+         }
 
-            char chPromoted = 0;
+         double dTime = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - tStart).count() / iRepeat;
 
-            current_game->parseMove(loaded_move[i], &from, &to, &chPromoted);
+         if ( 0 == iRound || dTime < dBest )
+         {
+            dBest = dTime;
+         }
+      }
 
-            // Check if line is valid
-            if ( from.iColumn < 0 || from.iColumn > 7 ||
-                 from.iRow    < 0 || from.iRow    > 7 ||
-                 to.iColumn   < 0 || to.iColumn   > 7 ||
-                 to.iRow      < 0 || to.iRow      > 7 )
-            {
-               createNextMessage("[Invalid] Can't load this game because there are invalid lines!\n");
+      cout.rdbuf(pConsole);
 
-               // Clear everything and return
-               current_game = new Game();
-               return;
-            }
+      times[name] = dBest;
 
-            // Is that move allowed? (should be because we already validated before saving)
-            Chess::EnPassant S_enPassant = { 0 };
-            Chess::Castling  S_castling  = { 0 };
-            Chess::Promotion S_promotion = { 0 };
+      // Report
+      bool   bPassed = true;
+      string reason;
 
-            if ( false == isMoveValid(from, to, &S_enPassant, &S_castling, &S_promotion) )
-            {
-               createNextMessage("[Invalid] Can't load this game because there are invalid moves!\n");
+      if ( expected.empty() )
+      {
+         bPassed = false;
+         reason  = "no [Expected] line, the game ends at: " + state;
+      }
+      else if ( expected != state )
+      {
+         bPassed = false;
+         reason  = "expected " + expected + ", got " + state;
+      }
 
-               // Clear everything and return
-               current_game = new Game();
-               return;
-            }
+      std::ostringstream timing;
+      timing << std::fixed << std::setprecision(1) << dBest << " us";
 
-            // ---------------------------------------------------
-            // A promotion occurred
-            // ---------------------------------------------------
-            if ( S_promotion.bApplied == true )
-            {
-               if ( chPromoted != 'Q' && chPromoted != 'R' && chPromoted != 'N' && chPromoted != 'B' )
-               {
-                  createNextMessage("[Invalid] Can't load this game because there is an invalid promotion!\n");
+      if ( baseline.count(name) > 0 && baseline[name] > 0 )
+      {
+         double dChange = 100.0 * (dBest - baseline[name]) / baseline[name];
 
-                  // Clear everything and return
-                  current_game = new Game();
-                  return;
-               }
+         timing << " (baseline " << baseline[name] << " us, " << std::showpos << dChange << std::noshowpos << "%)";
 
-               S_promotion.chBefore = current_game->getPieceAtPosition(from.iRow, from.iColumn);
+         if ( dChange > iThreshold )
+         {
+            bPassed = false;
+            reason += ( reason.empty() ? "" : "; " ) + string("slower than the baseline allows");
+         }
+      }
 
-               if (Chess::WHITE_PLAYER == current_game->getCurrentTurn())
-               {
-                  S_promotion.chAfter = toupper(chPromoted);
-               }
-               else
-               {
-                  S_promotion.chAfter = tolower(chPromoted);
-               }
-            }
+      cout << (bPassed ? "OK   " : "FAIL ") << left << setw(32) << name << right << timing.str();
 
+      if ( false == reason.empty() )
+      {
+         cout << ": " << reason;
+      }
 
-            // Log the move
-            current_game->logMove(loaded_move[i]);
+      cout << "\n";
+
+      if ( false == bPassed )
+      {
+         iFailed++;
+      }
+   }
+
+   // Before the pool it came from
+   delete current_game;
+   current_game = NULL;
+
+   if ( true == bUpdate && false == baseline_file.empty() )
+   {
+      std::ofstream ofs(baseline_file);
 
-            // Make the move
-            makeTheMove(from, to, &S_enPassant, &S_castling, &S_promotion);
+      for (std::map<string, double>::iterator it = times.begin(); it != times.end(); ++it)
+      {
+         ofs << it->first << " " << it->second << "\n";
+      }
+
+      cout << "Baseline saved as " << baseline_file << "\n";
+   }
+
+   cout << (files.size() - iFailed) << " passed, " << iFailed << " failed\n";
+
+   return ( 0 == iFailed ) ? 0 : 1;
+}
+
+//---------------------------------------------------------------------------------------
+// Script
+// The commands come from stdin, one per line, for the harnesses that pipe whole games in.
+// Nothing is drawn after each command, the results are only printed when asked for:
+//
+//    N                 New game (there is one already when the script starts)
+//    M E2-E4           Move, also written "M e2e4" or "M E7 E8 Q" for a promotion
+//    C                 Computer move
+//    U                 Undo
+//    S name            Save the game as name.dat
+//    L name            Load the game from name.dat
+//    B                 Print the situation and the board, as the menu shows them
+//    F                 Print the position, as in the [Expected] line of the replay
+//    R                 Print the message left by the last commands (captures, check...)
+//    Q                 Quit, same as the end of the input
+//
+// Empty lines and lines starting with '#' are skipped. A command that can't be done is
+// reported on stderr with its line number, and the script goes on with the next one.
+//
+// Usage: chess_console --script < commands.txt
+// Returns 0 if every command was done, 1 otherwise
+//---------------------------------------------------------------------------------------
+string getScriptMove(string argument)
+{
+   // "e2e4", "E2 E4", "E2-E4", "E7-E8=Q"... all become the saved games' format
+   string squares;
+
+   for (size_t i = 0; i < argument.length(); i++)
+   {
+      if ( ' ' != argument[i] && '-' != argument[i] && '=' != argument[i] )
+      {
+         squares += char( toupper(argument[i]) );
+      }
+   }
+
+   if ( 4 != squares.length() && 5 != squares.length() )
+   {
+      return "";
+   }
+
+   string move = squares.substr(0, 2) + "-" + squares.substr(2, 2);
+
+   if ( 5 == squares.length() )
+   {
+      move += string("=") + squares[4];
+   }
+
+   return move;
+}
+
+bool runScriptCommand(char chCommand, const string& argument, string* pError)
+{
+   switch ( toupper(chCommand) )
+   {
+      case 'N':
+      {
+         newGame();
+      }
+      break;
+
+      case 'M':
+      {
+         string move = getScriptMove(argument);
+
+         if ( true == current_game->isFinished() )
+         {
+            *pError = "this game has already finished";
+            return false;
+         }
+
+         if ( true == move.empty() )
+         {
+            *pError = "the move should be written as E2-E4";
+            return false;
+         }
+
+         if ( false == playMoveText(move, pError) )
+         {
+            return false;
          }
+
+         announceCheck();
       }
+      break;
 
-      // Extra line after the user input
-      createNextMessage("Game loaded from " + file_name + "\n");
+      case 'C':
+      {
+         if ( true == current_game->isFinished() )
+         {
+            *pError = "this game has already finished";
+            return false;
+         }
 
-      return;
+         computerMove();
+      }
+      break;
+
+      case 'U':
+      {
+         if ( false == current_game->undoIsPossible() )
+         {
+            *pError = "undo is not possible now";
+            return false;
+         }
+
+         undoMove();
+      }
+      break;
+
+      case 'S':
+      {
+         if ( false == saveGameAs(argument) )
+         {
+            *pError = "can't create " + argument + ".dat";
+            return false;
+         }
+      }
+      break;
+
+      case 'L':
+      {
+         if ( false == loadGameFrom(argument) )
+         {
+            *pError = "can't load " + argument + ".dat";
+            return false;
+         }
+      }
+      break;
+
+      case 'B':
+      {
+         printSituation(*current_game);
+         printBoard(*current_game);
+         presentFrame();
+      }
+      break;
+
+      case 'F':
+      {
+         string state = describeFinalState(true) + "\n";
+         terminalWrite(state.c_str(), state.length());
+      }
+      break;
+
+      case 'R':
+      {
+         printMessage();
+         presentFrame();
+      }
+      break;
+
+      default:
+      {
+         *pError = "unknown command";
+         return false;
+      }
    }
-   else
+
+   return true;
+}
+
+int runScript(void)
+{
+   bAllowPondering = false;
+
+   // What the rules print while checking the moves goes nowhere. The results are written
+   // straight to the output, and the errors go to cerr
+   NullBuffer      null_buffer;
+   std::streambuf* pSaved = cout.rdbuf(&null_buffer);
+
+   newGame();
+
+   string line;
+   int    iLine   = 0;
+   int    iFailed = 0;
+
+   while ( std::getline(cin, line) )
    {
-      createNextMessage("Error loading " + file_name + ". Creating a new game instead\n");
-      current_game = new Game();
-      return;
+      iLine++;
+
+      // Windows line endings, and the spaces around the command
+      size_t first = line.find_first_not_of(" \t\r");
+      size_t last  = line.find_last_not_of(" \t\r");
+
+      if ( string::npos == first || '#' == line[first] )
+      {
+         continue;
+      }
+
+      line = line.substr(first, last - first + 1);
+
+      if ( 'Q' == toupper(line[0]) && 1 == line.length() )
+      {
+         break;
+      }
+
+      size_t argument_start = line.find_first_not_of(" \t", 1);
+      string argument       = ( string::npos == argument_start ) ? "" : line.substr(argument_start);
+      string error;
+
+      bool bDone = false;
+
+      try
+      {
+         bDone = runScriptCommand(line[0], argument, &error);
+      }
+      catch (const char* s)
+      {
+         error = s;
+      }
+
+      if ( false == bDone )
+      {
+         cerr << "line " << iLine << ": " << line << ": " << error << "\n";
+         iFailed++;
+      }
    }
+
+   cout.rdbuf(pSaved);
+
+   return ( 0 == iFailed ) ? 0 : 1;
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+   bool bAlternateScreen = false;
+   bool bScript          = false;
+
+   // Started by a graphical interface: no menu, no board, just the protocol
+   for (int i = 1; i < argc; i++)
+   {
+      if ( 0 == strcmp(argv[i], "--uci") )
+      {
+         uciLoop();
+         return 0;
+      }
+
+      if ( 0 == strcmp(argv[i], "--stats") )
+      {
+         bShowSearchStats = true;
+      }
+
+      if ( 0 == strcmp(argv[i], "--alt-screen") )
+      {
+         bAlternateScreen = true;
+      }
+
+      if ( 0 == strcmp(argv[i], "--script") )
+      {
+         bScript = true;
+      }
+   }
+
+   // Search speed and signature of this build
+   if ( argc > 1 && 0 == strcmp(argv[1], "bench") )
+   {
+      return searchBench(argc - 1, argv + 1);
+   }
+
+   // The saved games, replayed through the rules
+   if ( argc > 1 && 0 == strcmp(argv[1], "replay") )
+   {
+      return replayGames(argc - 1, argv + 1);
+   }
+
+   // Many games at once, for the clients of a Unix domain socket
+   if ( argc > 1 && 0 == strcmp(argv[1], "server") )
+   {
+      return runServer(argc - 1, argv + 1);
+   }
+
+   // Commands from stdin, nothing is drawn unless asked for
+   if ( true == bScript )
+   {
+      return runScript();
+   }
+
+   // The user is told why a move is not valid
+   Chess::setExplanations(&cout);
+
+   // With --alt-screen the game gets a screen of its own, and the terminal is left as it was on exit
+   terminalInit(bAlternateScreen);
+
    bool bRun = true;
 
    // Clear screen an print the logo
@@ -824,8 +1259,8 @@ int main()
       printMessage();
       printMenu();
 
-      // Get input from user
-      cout << "Type here: ";
+      // Get input from user. The whole screen goes out here, in a single write
+      printPrompt("Type here: ");
       getline(cin, input);
 
       if (input.length() != 1)
@@ -834,6 +1269,13 @@ int main()
          continue;
       }
 
+      // Only a move by the user can match the prediction. Anything else
+      // (new game, undo, load, quit...) makes pondering useless
+      if ( 'M' != toupper(input[0]) && 'C' != toupper(input[0]) )
+      {
+         stopPondering();
+      }
+
       try
       {
          switch (input[0])
@@ -861,7 +1303,7 @@ int main()
                   else
                   {
                      movePiece();
-                     //clearScreen();
+                     clearScreen();
                      printLogo();
                      printSituation( *current_game );
                      printBoard( *current_game );
@@ -875,6 +1317,31 @@ int main()
             }
             break;
 
+            case 'C':
+            case 'c':
+            {
+               if (NULL != current_game)
+               {
+                  if ( current_game->isFinished() )
+                  {
+                     cout << "This game has already finished!\n";
+                  }
+                  else
+                  {
+                     computerMove();
+                     clearScreen();
+                     printLogo();
+                     printSituation( *current_game );
+                     printBoard( *current_game );
+                  }
+               }
+               else
+               {
+                  cout << "No game running!\n";
+               }
+            }
+            break;
+
             case 'Q':
             case 'q':
             {
@@ -888,7 +1355,7 @@ int main()
                if (NULL != current_game)
                {
                   undoMove();
-                  //clearScreen();
+                  clearScreen();
                   printLogo();
                   printSituation(*current_game);
                   printBoard(*current_game);
@@ -944,6 +1411,7 @@ int main()
       }
    }
 
+   stopPondering();
 
    return 0;
 }
@@ -0,0 +1,307 @@
+#include "includes.h"
+#include "player.h"
+
+#include <sstream>
+
+#ifndef _WIN32
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/wait.h>
+#endif
+
+
+// -------------------------------------------------------------------
+// InternalPlayer class
+// -------------------------------------------------------------------
+InternalPlayer::InternalPlayer(int iHash)
+{
+   m_pEngine = NULL;
+   m_iHash   = iHash;
+}
+
+InternalPlayer::~InternalPlayer()
+{
+   delete m_pEngine;
+}
+
+bool InternalPlayer::start(void)
+{
+   m_pEngine = new Engine();
+   m_pEngine->setHashSize(m_iHash);
+
+   return true;
+}
+
+bool InternalPlayer::setOptions(const string& options)
+{
+   std::istringstream iss(options);
+   string option;
+
+   while ( getline(iss, option, ',') )
+   {
+      size_t separator = option.find('=');
+
+      if ( string::npos == separator )
+      {
+         continue;
+      }
+
+      if ( false == m_pEngine->setOption(option.substr(0, separator), atoi(option.substr(separator + 1).c_str())) )
+      {
+         cerr << "Unknown engine option: " << option << "\n";
+         return false;
+      }
+   }
+
+   return true;
+}
+
+void InternalPlayer::newGame(void)
+{
+   m_pEngine->clearHash();
+}
+
+string InternalPlayer::getMove(const std::vector<string>& moves, const Engine::Limits& limits)
+{
+   // Replaying the moves also gives the engine the history it needs to see repetitions
+   m_pEngine->setFen(Engine::START_FEN);
+
+   for (unsigned i = 0; i < moves.size(); i++)
+   {
+      m_pEngine->playMove(moves[i]);
+   }
+
+   Engine::Move move;
+
+   if ( false == m_pEngine->think(limits, &move) )
+   {
+      return "";
+   }
+
+   return Engine::moveToUci(move);
+}
+
+
+// -------------------------------------------------------------------
+// UciPlayer class
+// -------------------------------------------------------------------
+UciPlayer::UciPlayer(const string& command, int iHash)
+{
+   m_command     = command;
+   m_iHash       = iHash;
+   m_iProcess    = -1;
+   m_fdToEngine  = -1;
+   m_pFromEngine = NULL;
+}
+
+UciPlayer::~UciPlayer()
+{
+#ifndef _WIN32
+   if ( -1 != m_iProcess )
+   {
+      send("quit");
+      close(m_fdToEngine);
+      fclose(m_pFromEngine);
+      waitpid(m_iProcess, NULL, 0);
+   }
+#endif
+}
+
+bool UciPlayer::start(void)
+{
+#ifdef _WIN32
+   cerr << "External engines are not supported on this platform\n";
+   return false;
+#else
+   // The command line, split in words
+   std::istringstream iss(m_command);
+   std::vector<string> words;
+   string word;
+
+   while ( iss >> word )
+   {
+      words.push_back(word);
+   }
+
+   if ( true == words.empty() )
+   {
+      return false;
+   }
+
+   std::vector<char*> argv;
+
+   for (unsigned i = 0; i < words.size(); i++)
+   {
+      argv.push_back(&words[i][0]);
+   }
+
+   argv.push_back(NULL);
+
+   int to_engine[2];
+   int from_engine[2];
+
+   // Close-on-exec from the start: an engine started by another thread between pipe() and
+   // fcntl() would inherit them, and never see the end of its input
+   if ( 0 != pipe2(to_engine, O_CLOEXEC) )
+   {
+      return false;
+   }
+
+   if ( 0 != pipe2(from_engine, O_CLOEXEC) )
+   {
+      close(to_engine[0]);
+      close(to_engine[1]);
+      return false;
+   }
+
+   m_iProcess = fork();
+
+   if ( 0 == m_iProcess )
+   {
+      // Child: stdin and stdout become the pipes
+      dup2(to_engine[0], STDIN_FILENO);
+      dup2(from_engine[1], STDOUT_FILENO);
+
+      close(to_engine[0]);
+      close(to_engine[1]);
+      close(from_engine[0]);
+      close(from_engine[1]);
+
+      execvp(argv[0], &argv[0]);
+      _exit(127);
+   }
+
+   close(to_engine[0]);
+   close(from_engine[1]);
+
+   if ( m_iProcess < 0 )
+   {
+      close(to_engine[1]);
+      close(from_engine[0]);
+      return false;
+   }
+
+   // A dead engine must not kill the match
+   signal(SIGPIPE, SIG_IGN);
+
+   m_fdToEngine  = to_engine[1];
+   m_pFromEngine = fdopen(from_engine[0], "r");
+
+   send("uci");
+
+   if ( true == waitFor("uciok").empty() )
+   {
+      cerr << "'" << m_command << "' is not a UCI engine\n";
+      return false;
+   }
+
+   send("setoption name Hash value " + std::to_string(m_iHash));
+   send("isready");
+
+   return ( false == waitFor("readyok").empty() );
+#endif
+}
+
+bool UciPlayer::setOptions(const string& options)
+{
+   // "NullMove=0" becomes "setoption name NullMove value 0"
+   std::istringstream iss(options);
+   string option;
+
+   while ( getline(iss, option, ',') )
+   {
+      size_t separator = option.find('=');
+
+      if ( string::npos != separator )
+      {
+         string value = option.substr(separator + 1);
+
+         // Check boxes are "true" or "false" in UCI
+         if ( "0" == value ) value = "false";
+         if ( "1" == value ) value = "true";
+
+         send("setoption name " + option.substr(0, separator) + " value " + value);
+      }
+   }
+
+   send("isready");
+
+   return ( false == waitFor("readyok").empty() );
+}
+
+void UciPlayer::newGame(void)
+{
+   send("ucinewgame");
+   send("isready");
+   waitFor("readyok");
+}
+
+string UciPlayer::getMove(const std::vector<string>& moves, const Engine::Limits& limits)
+{
+   string position = "position startpos";
+
+   if ( false == moves.empty() )
+   {
+      position += " moves";
+
+      for (unsigned i = 0; i < moves.size(); i++)
+      {
+         position += " " + moves[i];
+      }
+   }
+
+   send(position);
+
+   std::ostringstream go;
+   go << "go";
+
+   if ( limits.iDepth > 0 )    go << " depth "    << limits.iDepth;
+   if ( limits.iNodes > 0 )    go << " nodes "    << limits.iNodes;
+   if ( limits.iMoveTime > 0 ) go << " movetime " << limits.iMoveTime;
+
+   send(go.str());
+
+   // "bestmove e2e4 ponder e7e5"
+   std::istringstream iss(waitFor("bestmove"));
+   string word;
+   string move;
+
+   iss >> word >> move;
+
+   if ( "0000" == move || "(none)" == move )
+   {
+      return "";
+   }
+
+   return move;
+}
+
+void UciPlayer::send(const string& line)
+{
+#ifndef _WIN32
+   string text = line + "\n";
+
+   if ( write(m_fdToEngine, text.c_str(), text.length()) < 0 )
+   {
+      // The process is gone, waitFor() will notice
+   }
+#endif
+}
+
+string UciPlayer::waitFor(const string& expected)
+{
+   char line[4096];
+
+   while ( NULL != m_pFromEngine && NULL != fgets(line, sizeof(line), m_pFromEngine) )
+   {
+      if ( 0 == strncmp(line, expected.c_str(), expected.length()) )
+      {
+         string text = line;
+         text.erase(text.find_last_not_of("\r\n") + 1);
+         return text;
+      }
+   }
+
+   return "";
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include "engine.h"
+
+// -------------------------------------------------------------------
+// Player
+// Someone who can be asked for a move in a match: the engine of this
+// build, or another build (or any UCI engine) running as a process
+// -------------------------------------------------------------------
+class Player
+{
+public:
+   virtual ~Player() {}
+
+   // False if the player could not be started
+   virtual bool start( void ) = 0;
+
+   // Options as "Name=value,Name=value"
+   virtual bool setOptions( const string& options ) = 0;
+
+   virtual void newGame( void ) = 0;
+
+   // Best move (UCI notation) in the position after 'moves', played from the initial position.
+   // Empty if there is none
+   virtual string getMove( const std::vector<string>& moves, const Engine::Limits& limits ) = 0;
+};
+
+class InternalPlayer : public Player
+{
+public:
+   InternalPlayer( int iHash );
+   ~InternalPlayer();
+
+   bool start( void );
+
+   bool setOptions( const string& options );
+
+   void newGame( void );
+
+   string getMove( const std::vector<string>& moves, const Engine::Limits& limits );
+
+private:
+   Engine* m_pEngine;
+   int     m_iHash;
+};
+
+class UciPlayer : public Player
+{
+public:
+   // e.g. "../old_build/chess --uci"
+   UciPlayer( const string& command, int iHash );
+   ~UciPlayer();
+
+   bool start( void );
+
+   bool setOptions( const string& options );
+
+   void newGame( void );
+
+   string getMove( const std::vector<string>& moves, const Engine::Limits& limits );
+
+private:
+   void send( const string& line );
+
+   // Reads until a line starting with 'expected', returns that line (empty if the process is gone)
+   string waitFor( const string& expected );
+
+   string m_command;
+   int    m_iHash;
+   int    m_iProcess;
+   int    m_fdToEngine;
+   FILE*  m_pFromEngine;
+};
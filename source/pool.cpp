@@ -0,0 +1,203 @@
+#include "includes.h"
+#include "pool.h"
+
+#include <new>
+
+
+// -------------------------------------------------------------------
+// Blocks
+// Every block starts with the pool it came from (NULL for the heap) and its size class,
+// which is all poolFree() needs. The header keeps the block aligned for any type
+// -------------------------------------------------------------------
+union BlockHeader
+{
+   struct
+   {
+      SlabPool* pPool;
+      int       iClass;
+   } info;
+
+   std::max_align_t align;
+};
+
+static BlockHeader* getHeader(void* p)
+{
+   return (BlockHeader*) p - 1;
+}
+
+static void* allocateFromHeap(size_t iSize)
+{
+   BlockHeader* pHeader = (BlockHeader*) ::operator new(sizeof(BlockHeader) + iSize);
+
+   pHeader->info.pPool  = NULL;
+   pHeader->info.iClass = -1;
+
+   return pHeader + 1;
+}
+
+// The pool installed by PoolScope on this thread
+static thread_local SlabPool* pThreadPool = NULL;
+
+
+// -------------------------------------------------------------------
+// SlabPool
+// -------------------------------------------------------------------
+SlabPool::SlabPool() : m_pSlabs(NULL), m_iNumSlabs(0), m_pNext(NULL), m_pEnd(NULL), m_pRemote(NULL)
+{
+   memset(m_pFree, 0, sizeof(m_pFree));
+}
+
+SlabPool::~SlabPool()
+{
+   // Everything at once, without looking at the blocks
+   while ( NULL != m_pSlabs )
+   {
+      char* pPrevious = *(char**) m_pSlabs;
+
+      ::operator delete(m_pSlabs);
+
+      m_pSlabs = pPrevious;
+   }
+}
+
+void* SlabPool::allocate(size_t iSize)
+{
+   size_t iBlock = (sizeof(BlockHeader) + iSize + GRANULARITY - 1) / GRANULARITY * GRANULARITY;
+
+   if ( iBlock > MAX_BLOCK )
+   {
+      return allocateFromHeap(iSize);
+   }
+
+   int iClass = (int) (iBlock / GRANULARITY) - 1;
+
+   // A block of this size that was freed. The ones freed by other threads are only looked
+   // at when there is none here
+   if ( NULL == m_pFree[iClass] && NULL != m_pRemote.load(std::memory_order_relaxed) )
+   {
+      takeRemoteBlocks();
+   }
+
+   if ( NULL != m_pFree[iClass] )
+   {
+      FreeBlock* pBlock = m_pFree[iClass];
+
+      m_pFree[iClass] = pBlock->pNext;
+
+      return pBlock;
+   }
+
+   // A new one, from the last slab or a new slab. The end of the last one is lost
+   if ( iBlock > (size_t) (m_pEnd - m_pNext) )
+   {
+      char* pSlab = (char*) ::operator new(SLAB_SIZE);
+
+      *(char**) pSlab = m_pSlabs;
+
+      m_pSlabs = pSlab;
+      m_iNumSlabs++;
+
+      m_pNext = pSlab + sizeof(BlockHeader);
+      m_pEnd  = pSlab + SLAB_SIZE;
+   }
+
+   BlockHeader* pHeader = (BlockHeader*) m_pNext;
+
+   pHeader->info.pPool  = this;
+   pHeader->info.iClass = iClass;
+
+   m_pNext += iBlock;
+
+   return pHeader + 1;
+}
+
+size_t SlabPool::getSize(void)
+{
+   return (size_t) m_iNumSlabs * SLAB_SIZE;
+}
+
+void SlabPool::freeLocal(void* pBlock, int iClass)
+{
+   FreeBlock* pFree = (FreeBlock*) pBlock;
+
+   pFree->pNext    = m_pFree[iClass];
+   m_pFree[iClass] = pFree;
+}
+
+void SlabPool::freeRemote(void* pBlock)
+{
+   FreeBlock* pFree = (FreeBlock*) pBlock;
+
+   pFree->pNext = m_pRemote.load(std::memory_order_relaxed);
+
+   while ( false == m_pRemote.compare_exchange_weak(pFree->pNext, pFree, std::memory_order_release, std::memory_order_relaxed) )
+   {
+      // pFree->pNext now has the new head, try again
+   }
+}
+
+void SlabPool::takeRemoteBlocks(void)
+{
+   // All of them at once: the other threads only ever add to the list
+   FreeBlock* pBlock = m_pRemote.exchange(NULL, std::memory_order_acquire);
+
+   while ( NULL != pBlock )
+   {
+      FreeBlock* pNext = pBlock->pNext;
+
+      freeLocal(pBlock, getHeader(pBlock)->info.iClass);
+
+      pBlock = pNext;
+   }
+}
+
+
+// -------------------------------------------------------------------
+// PoolScope
+// -------------------------------------------------------------------
+PoolScope::PoolScope(SlabPool* pPool) : m_pPrevious(pThreadPool)
+{
+   pThreadPool = pPool;
+}
+
+PoolScope::~PoolScope()
+{
+   pThreadPool = m_pPrevious;
+}
+
+
+// -------------------------------------------------------------------
+// Functions
+// -------------------------------------------------------------------
+void* poolAllocate(size_t iSize)
+{
+   if ( NULL == pThreadPool )
+   {
+      return allocateFromHeap(iSize);
+   }
+
+   return pThreadPool->allocate(iSize);
+}
+
+void poolFree(void* p)
+{
+   if ( NULL == p )
+   {
+      return;
+   }
+
+   BlockHeader* pHeader = getHeader(p);
+
+   if ( NULL == pHeader->info.pPool )
+   {
+      ::operator delete(pHeader);
+   }
+   else if ( pThreadPool == pHeader->info.pPool )
+   {
+      pHeader->info.pPool->freeLocal(p, pHeader->info.iClass);
+   }
+   else
+   {
+      pHeader->info.pPool->freeRemote(p);
+   }
+}
@@ -0,0 +1,113 @@
+#pragma once
+#include "includes.h"
+
+#include <atomic>
+#include <cstddef>
+
+//---------------------------------------------------------------------------------------
+// Slab pools
+// Games, and the chunks holding their moves, for the modes that create and free many of
+// them: the server, the replay, selfplay. A pool carves blocks out of 64 KB slabs and
+// keeps the freed ones for the next allocation of the same size, so thousands of games
+// per second do not go through the heap (and its lock) at all. Its slabs are given back
+// all at once when it is destroyed, at the end of the batch.
+//
+// A pool belongs to one thread, which installs it with PoolScope. Where no pool is
+// installed poolAllocate() is plain operator new, so programs using the rules without
+// knowing about pools (the C API, the console) work as before.
+//
+// Any thread can free a block. If it is not the thread of the pool, the block goes to a
+// list the pool takes back on its next allocation
+//---------------------------------------------------------------------------------------
+class SlabPool
+{
+public:
+   SlabPool();
+
+   // All the blocks must have been freed, or at least never be used again
+   ~SlabPool();
+
+   void* allocate( size_t iSize );
+
+   // Bytes taken from the heap for the slabs, for the statistics
+   size_t getSize( void );
+
+   // Only called by poolFree()
+   void freeLocal( void* pBlock, int iClass );
+   void freeRemote( void* pBlock );
+
+private:
+   SlabPool( const SlabPool& );
+   SlabPool& operator=( const SlabPool& );
+
+   enum
+   {
+      SLAB_SIZE   = 64 * 1024,
+      GRANULARITY = 16,   // Block sizes, header included, are multiples of this
+      MAX_BLOCK   = 4096, // Larger blocks come from the heap
+      NUM_CLASSES = MAX_BLOCK / GRANULARITY
+   };
+
+   // A free block, written over what it held
+   struct FreeBlock
+   {
+      FreeBlock* pNext;
+   };
+
+   void takeRemoteBlocks( void );
+
+   // The slabs, each one starting with a pointer to the one before
+   char* m_pSlabs;
+   int   m_iNumSlabs;
+
+   // What is left of the last slab
+   char* m_pNext;
+   char* m_pEnd;
+
+   // Freed blocks by size: m_pFree[i] are blocks of (i + 1) * GRANULARITY bytes
+   FreeBlock* m_pFree[NUM_CLASSES];
+
+   // Freed by other threads
+   std::atomic<FreeBlock*> m_pRemote;
+};
+
+// Installs a pool for the allocations of this thread until the end of the scope
+class PoolScope
+{
+public:
+   explicit PoolScope( SlabPool* pPool );
+   ~PoolScope();
+
+private:
+   SlabPool* m_pPrevious;
+};
+
+// From the pool of this thread, or the heap if there is none. Throws std::bad_alloc
+void* poolAllocate( size_t iSize );
+
+// Wherever the block came from. NULL is ignored
+void poolFree( void* p );
+
+// For the containers of the classes that live in the pools, e.g. the move history
+template <class T>
+class PoolAllocator
+{
+public:
+   typedef T value_type;
+
+   PoolAllocator() {}
+
+   template <class U>
+   PoolAllocator( const PoolAllocator<U>& ) {}
+
+   T* allocate( size_t n ) { return (T*) poolAllocate(n * sizeof(T)); }
+
+   void deallocate( T* p, size_t ) { poolFree(p); }
+};
+
+// poolFree() finds the pool of each block, so any allocator can free what another allocated
+template <class T, class U>
+bool operator==( const PoolAllocator<T>&, const PoolAllocator<U>& ) { return true; }
+
+template <class T, class U>
+bool operator!=( const PoolAllocator<T>&, const PoolAllocator<U>& ) { return false; }
@@ -0,0 +1,173 @@
+#include "includes.h"
+#include <sstream>
+
+#include "search_bench.h"
+
+
+//---------------------------------------------------------------------------------------
+// Bench
+// Usage: chess_console bench [depth] [directory with the saved games]
+//
+// Every position is searched from scratch (empty hash, no history), so the number of
+// nodes depends only on the position, the depth and the search code
+//---------------------------------------------------------------------------------------
+enum
+{
+   DEFAULT_DEPTH = 7,
+   GAME_SAMPLING = 12   // Half moves between two positions taken from a saved game
+};
+
+static const char* bench_fens[] =
+{
+   "rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+   "r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+   "8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+   "r3k2r/Pppp1ppp/1b3nbN/nP6/BBP1P3/q4N2/Pp1P2PP/R2Q1RK1 w kq - 0 1",
+   "rnbq1k1r/pp1Pbppp/2p5/8/2B5/8/PPP1NnPP/RNBQK2R w KQ - 1 8",
+   "r4rk1/1pp1qppp/p1np1n2/2b1p1B1/2B1P1b1/P1NP1N2/1PP1QPPP/R4RK1 w - - 0 10",
+   "r1bq1rk1/pp2ppbp/2np1np1/8/3NP3/2N1BP2/PPPQ2PP/R3KB1R w KQ - 3 9",
+   "6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+};
+
+// Saved games, the same files as the console loads
+static const char* bench_games[] =
+{
+   "KasparovVSdeepblue_game_1.dat",
+   "kasparov_2.dat",
+   "castling_both.dat",
+   "passant_done.dat",
+   "black_promote.dat",
+   "white_promote.dat",
+};
+
+static int loadGamePositions(Engine* pEngine, const string& file_name, std::vector<string>* pFens)
+{
+   // Replays the game and keeps some of the positions along the way, and the last one.
+   // Returns how many positions were taken, -1 if the file could not be opened
+   std::ifstream ifs(file_name);
+
+   if ( false == ifs.is_open() )
+   {
+      return -1;
+   }
+
+   pEngine->setFen(Engine::START_FEN);
+
+   int    iHalfMoves = 0;
+   int    iTaken     = 0;
+   bool   bValid     = true;
+   string line;
+
+   while ( true == bValid && std::getline(ifs, line) )
+   {
+      // Skip lines that starts with "[]"
+      if ( 0 == line.compare(0, 1, "[") )
+      {
+         continue;
+      }
+
+      std::istringstream iss(line);
+      string text;
+
+      while ( iss >> text )
+      {
+         if ( "|" == text )
+         {
+            continue;
+         }
+
+         if ( false == pEngine->playMove(text) )
+         {
+            // The rest of the game can't be trusted
+            bValid = false;
+            break;
+         }
+
+         iHalfMoves++;
+
+         if ( 0 == iHalfMoves % GAME_SAMPLING )
+         {
+            pFens->push_back(pEngine->getFen());
+            iTaken++;
+         }
+      }
+   }
+
+   if ( 0 != iHalfMoves % GAME_SAMPLING )
+   {
+      pFens->push_back(pEngine->getFen());
+      iTaken++;
+   }
+
+   return iTaken;
+}
+
+int searchBench(int argc, char* argv[])
+{
+   // argv[0] is "bench"
+   int    iDepth    = DEFAULT_DEPTH;
+   string directory = "test";
+
+   if ( argc > 1 )
+   {
+      iDepth = atoi(argv[1]);
+
+      if ( iDepth <= 0 )
+      {
+         cout << "Invalid depth: " << argv[1] << "\n";
+         return 1;
+      }
+   }
+
+   if ( argc > 2 )
+   {
+      directory = argv[2];
+   }
+
+   Engine* pEngine = new Engine();
+   pEngine->setHashSize(16);
+
+   std::vector<string> fens(bench_fens, bench_fens + sizeof(bench_fens) / sizeof(bench_fens[0]));
+
+   for (unsigned i = 0; i < sizeof(bench_games) / sizeof(bench_games[0]); i++)
+   {
+      string file_name = directory + "/" + bench_games[i];
+
+      if ( -1 == loadGamePositions(pEngine, file_name, &fens) )
+      {
+         // Still runs, but the signature will not match
+         cerr << "Could not open " << file_name << ", the node count is not comparable\n";
+      }
+   }
+
+   long long iTotalNodes = 0;
+
+   auto tStart = std::chrono::steady_clock::now();
+
+   for (unsigned i = 0; i < fens.size(); i++)
+   {
+      pEngine->setFen(fens[i]);
+      pEngine->clearHash();
+
+      Engine::Move best_move;
+      pEngine->think(iDepth, &best_move);
+
+      iTotalNodes += pEngine->getNodes();
+
+      cerr << "Position " << (i + 1) << "/" << fens.size() << " (" << fens[i] << "): " << pEngine->getNodes() << " nodes\n";
+   }
+
+   long long iElapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count();
+
+   delete pEngine;
+
+   // The summary goes to stdout, so a script can keep only that
+   cout << "===========================\n";
+   cout << "Positions      : " << fens.size() << "\n";
+   cout << "Depth          : " << iDepth << "\n";
+   cout << "Total time (ms): " << iElapsed << "\n";
+   cout << "Nodes searched : " << iTotalNodes << "\n";
+   cout << "Nodes/second   : " << (iTotalNodes * 1000 / max(iElapsed, 1LL)) << "\n";
+
+   return 0;
+}
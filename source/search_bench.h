@@ -0,0 +1,7 @@
+#pragma once
+#include "engine.h"
+
+// Searches a fixed set of positions to a fixed depth and prints the nodes and the speed.
+// The total of nodes is a signature of the search: any change in it means the search
+// itself changed, not just its speed. Returns the exit code
+int searchBench( int argc, char* argv[] );
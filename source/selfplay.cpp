@@ -0,0 +1,524 @@
+#include "includes.h"
+
+#include "chess.h"
+#include "engine.h"
+#include "player.h"
+#include "sprt.h"
+
+#include <map>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <sstream>
+#include <ctime>
+
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+
+
+//---------------------------------------------------------------------------------------
+// Self-play
+// Engine A against engine B, many games at the same time. Every game is played twice
+// from the same opening, once with each color. Each game is saved in the same format
+// as saveGame() and the results go to an Elo/SPRT summary
+//
+// A and B are this build's engine, with the options given by -a and -b, unless
+// --engine-a or --engine-b name another build (any UCI engine, really) to run instead.
+// With --sprt the match is a regression gate: it stops as soon as the test is decided,
+// and the exit code is 0 if H1 was accepted, 2 if H0 was accepted, 3 if undecided
+//
+// Usage: selfplay [--games N] [--concurrency N] [--depth N] [--nodes N] [--movetime ms]
+//                 [--hash MB] [--openings file] [--out prefix, "" to not save the games]
+//                 [-a Option=value,...] [-b Option=value,...]
+//                 [--engine-a "command"] [--engine-b "command"]
+//                 [--sprt] [--elo0 x] [--elo1 x] [--alpha x] [--beta x]
+//---------------------------------------------------------------------------------------
+struct Settings
+{
+   int            iGames;       // Maximum, with --sprt
+   int            iConcurrency;
+   int            iHash;
+   Engine::Limits limits;
+   string         openings_file;
+   string         out_prefix;
+   string         options[2];   // Engine A and B
+   string         commands[2];  // Empty for this build's engine
+   bool           bSprt;
+   double         dElo0;
+   double         dElo1;
+   double         dAlpha;
+   double         dBeta;
+};
+
+struct GameResult
+{
+   double dScoreWhite;          // 1, 0.5 or 0
+   string reason;
+};
+
+// A few balanced openings, as moves from the initial position
+static const char* default_openings[] =
+{
+   "e2e4 e7e5 g1f3 b8c6",
+   "e2e4 c7c5 g1f3 d7d6",
+   "e2e4 e7e6 d2d4 d7d5",
+   "e2e4 c7c6 d2d4 d7d5",
+   "e2e4 d7d6 d2d4 g8f6",
+   "e2e4 g7g6 d2d4 f8g7",
+   "e2e4 e7e5 f1c4 g8f6",
+   "e2e4 e7e5 g1f3 g8f6",
+   "d2d4 d7d5 c2c4 e7e6",
+   "d2d4 d7d5 c2c4 c7c6",
+   "d2d4 g8f6 c2c4 e7e6",
+   "d2d4 g8f6 c2c4 g7g6",
+   "d2d4 f7f5 g1f3 g8f6",
+   "d2d4 d7d5 g1f3 g8f6",
+   "c2c4 e7e5 b1c3 g8f6",
+   "c2c4 c7c5 g1f3 b8c6",
+   "g1f3 d7d5 g2g3 g8f6",
+   "g1f3 g8f6 c2c4 e7e6",
+};
+
+static std::mutex output_mutex;
+
+static bool isInsufficientMaterial(Game& game)
+{
+   // Only the kings, possibly with one knight or bishop
+   int iMinors = 0;
+
+   for (int i = 0; i < 8; i++)
+   {
+      for (int j = 0; j < 8; j++)
+      {
+         switch (toupper(game.getPieceAtPosition(i, j)))
+         {
+            case 'N':
+            case 'B':
+            {
+               iMinors++;
+            }
+            break;
+
+            case 'P':
+            case 'R':
+            case 'Q':
+            {
+               return false;
+            }
+            break;
+         }
+      }
+   }
+
+   return ( iMinors <= 1 );
+}
+
+static GameResult playGame(const Settings& settings, const string& opening, Player* players[2], Engine* pReferee, Game& game)
+{
+   // players[WHITE_PLAYER] plays white. The referee engine knows the rules, it does not search
+   GameResult result;
+
+   std::vector<string>   moves;
+   std::map<string, int> positions;
+   int iHalfMoveClock = 0;
+
+   pReferee->setFen(Engine::START_FEN);
+   players[0]->newGame();
+   players[1]->newGame();
+
+   // The opening moves are played by nobody in particular
+   std::istringstream iss(opening);
+   string text;
+
+   while ( iss >> text )
+   {
+      Engine::Move move;
+
+      if ( false == pReferee->findLegalMove(text, &move) )
+      {
+         break;
+      }
+
+      Engine::applyMove(game, move);
+      pReferee->playMove(text);
+      moves.push_back(Engine::moveToUci(move));
+   }
+
+   while ( true )
+   {
+      int iTurn = game.getCurrentTurn();
+
+      Engine::Move legal_moves[Engine::MAX_MOVES];
+
+      if ( 0 == pReferee->getLegalMoves(legal_moves, Engine::MAX_MOVES) )
+      {
+         if ( true == game.playerKingInCheck() )
+         {
+            result.dScoreWhite = (Chess::WHITE_PLAYER == iTurn) ? 0.0 : 1.0;
+            result.reason      = "checkmate";
+         }
+         else
+         {
+            result.dScoreWhite = 0.5;
+            result.reason      = "stalemate";
+         }
+         break;
+      }
+
+      string       uci = players[iTurn]->getMove(moves, settings.limits);
+      Engine::Move move;
+
+      if ( false == pReferee->findLegalMove(uci, &move) )
+      {
+         // Also when an external engine crashed
+         result.dScoreWhite = (Chess::WHITE_PLAYER == iTurn) ? 0.0 : 1.0;
+         result.reason      = "illegal move '" + uci + "'";
+         break;
+      }
+
+      // A pawn move or a capture can't be undone, so it resets the 50 moves count
+      if ( 'P' == toupper(game.getPieceAtPosition(move.from)) || EMPTY_SQUARE != game.getPieceAtPosition(move.to) )
+      {
+         iHalfMoveClock = 0;
+      }
+      else
+      {
+         iHalfMoveClock++;
+      }
+
+      Engine::applyMove(game, move);
+      pReferee->playMove(uci);
+      moves.push_back(uci);
+
+      if ( ++positions[pReferee->getFen()] >= 3 )
+      {
+         result.dScoreWhite = 0.5;
+         result.reason      = "threefold repetition";
+         break;
+      }
+
+      if ( iHalfMoveClock >= 100 )
+      {
+         result.dScoreWhite = 0.5;
+         result.reason      = "50 moves rule";
+         break;
+      }
+
+      if ( true == isInsufficientMaterial(game) )
+      {
+         result.dScoreWhite = 0.5;
+         result.reason      = "insufficient material";
+         break;
+      }
+
+      if ( game.getNumRounds() >= 250 )
+      {
+         result.dScoreWhite = 0.5;
+         result.reason      = "adjudicated, too long";
+         break;
+      }
+   }
+
+   return result;
+}
+
+static void saveResult(const Settings& settings, int iGame, Game& game, const string& white, const string& black, const GameResult& result)
+{
+   if ( true == settings.out_prefix.empty() )
+   {
+      return;
+   }
+
+   std::ostringstream file_name;
+   file_name << settings.out_prefix << std::setw(5) << std::setfill('0') << iGame + 1 << ".dat";
+
+   std::ofstream ofs(file_name.str());
+
+   if ( false == ofs.is_open() )
+   {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      cerr << "Error creating " << file_name.str() << "\n";
+      return;
+   }
+
+   // Same as saveGame(), the extra lines in brackets are skipped by loadGame()
+   auto time_now = std::chrono::system_clock::now();
+   std::time_t end_time = std::chrono::system_clock::to_time_t(time_now);
+   ofs << "[Chess console] Saved at: " << std::ctime(&end_time);
+
+   const char* score = (1.0 == result.dScoreWhite) ? "1-0" : (0.0 == result.dScoreWhite) ? "0-1" : "1/2-1/2";
+   ofs << "[Selfplay] White: " << white << " Black: " << black << " Result: " << score << " (" << result.reason << ")\n";
+
+   for (int i = 0; i < game.getNumRounds(); i++)
+   {
+      ofs << game.getRoundText(i) << "\n";
+   }
+}
+
+static std::atomic<bool> match_over(false);
+
+static void worker(const Settings& settings, const std::vector<string>& openings, std::atomic<int>* pNextGame, Sprt* pSprt)
+{
+   // Each thread has its own players, and a new Game for every game. The games and the
+   // positions of the engines come from the pool of the thread, which is released when
+   // the players are gone
+   SlabPool  pool;
+   PoolScope scope(&pool);
+
+   Player* players[2];
+   bool    bStarted = true;
+
+   for (int i = 0; i < 2; i++)
+   {
+      if ( true == settings.commands[i].empty() )
+      {
+         players[i] = new InternalPlayer(settings.iHash);
+      }
+      else
+      {
+         players[i] = new UciPlayer(settings.commands[i], settings.iHash);
+      }
+
+      if ( false == players[i]->start() || false == players[i]->setOptions(settings.options[i]) )
+      {
+         bStarted = false;
+      }
+   }
+
+   Engine* pReferee = new Engine();
+   pReferee->setHashSize(1);
+
+   if ( false == bStarted )
+   {
+      std::lock_guard<std::mutex> lock(output_mutex);
+      cerr << "Could not start the engines\n";
+      match_over = true;
+   }
+
+   while ( false == match_over )
+   {
+      int iGame = (*pNextGame)++;
+
+      if ( iGame >= settings.iGames )
+      {
+         break;
+      }
+
+      // Even games: A has white. Odd games: same opening, B has white
+      int     iA = iGame % 2;
+      Player* sides[2];
+
+      sides[Chess::WHITE_PLAYER] = players[iA];
+      sides[Chess::BLACK_PLAYER] = players[1 - iA];
+
+      Game* pGame = new Game();
+
+      GameResult result = playGame(settings, openings[(iGame / 2) % openings.size()], sides, pReferee, *pGame);
+
+      saveResult(settings, iGame, *pGame, (0 == iA) ? "A" : "B", (0 == iA) ? "B" : "A", result);
+
+      delete pGame;
+
+      std::lock_guard<std::mutex> lock(output_mutex);
+
+      // A game still running when the test was decided does not count
+      if ( true == match_over )
+      {
+         break;
+      }
+
+      pSprt->addResult((0 == iA) ? result.dScoreWhite : 1.0 - result.dScoreWhite);
+
+      if ( 0 == pSprt->getGames() % 10 )
+      {
+         cout << pSprt->getSummary() << endl;
+      }
+
+      if ( true == settings.bSprt && Sprt::CONTINUE != pSprt->getDecision() )
+      {
+         match_over = true;
+      }
+   }
+
+   delete pReferee;
+   delete players[0];
+   delete players[1];
+}
+
+static bool readSettings(int argc, char* argv[], Settings* pSettings)
+{
+   memset(&pSettings->limits, 0, sizeof(Engine::Limits));
+
+   pSettings->iGames        = 100;
+   pSettings->iConcurrency  = max(1, (int)std::thread::hardware_concurrency());
+   pSettings->iHash         = 4;
+   pSettings->out_prefix    = "selfplay_";
+   pSettings->bSprt         = false;
+   pSettings->dElo0         = 0.0;
+   pSettings->dElo1         = 5.0;
+   pSettings->dAlpha        = 0.05;
+   pSettings->dBeta         = 0.05;
+
+   for (int i = 1; i < argc; i++)
+   {
+      string arg = argv[i];
+
+      if ( "--sprt" == arg )
+      {
+         pSettings->bSprt = true;
+         continue;
+      }
+
+      if ( i + 1 >= argc )
+      {
+         cerr << "Missing value for " << arg << "\n";
+         return false;
+      }
+
+      string value = argv[++i];
+
+      if      ( "--games"       == arg ) pSettings->iGames           = atoi(value.c_str());
+      else if ( "--concurrency" == arg ) pSettings->iConcurrency     = max(1, atoi(value.c_str()));
+      else if ( "--depth"       == arg ) pSettings->limits.iDepth    = atoi(value.c_str());
+      else if ( "--nodes"       == arg ) pSettings->limits.iNodes    = atoll(value.c_str());
+      else if ( "--movetime"    == arg ) pSettings->limits.iMoveTime = atoi(value.c_str());
+      else if ( "--hash"        == arg ) pSettings->iHash            = atoi(value.c_str());
+      else if ( "--openings"    == arg ) pSettings->openings_file    = value;
+      else if ( "--out"         == arg ) pSettings->out_prefix       = value;
+      else if ( "-a"            == arg ) pSettings->options[0]       = value;
+      else if ( "-b"            == arg ) pSettings->options[1]       = value;
+      else if ( "--engine-a"    == arg ) pSettings->commands[0]      = value;
+      else if ( "--engine-b"    == arg ) pSettings->commands[1]      = value;
+      else if ( "--elo0"        == arg ) pSettings->dElo0            = atof(value.c_str());
+      else if ( "--elo1"        == arg ) pSettings->dElo1            = atof(value.c_str());
+      else if ( "--alpha"       == arg ) pSettings->dAlpha           = atof(value.c_str());
+      else if ( "--beta"        == arg ) pSettings->dBeta            = atof(value.c_str());
+      else
+      {
+         cerr << "Unknown argument " << arg << "\n";
+         return false;
+      }
+   }
+
+   // Without any limit a game would never end
+   if ( 0 == pSettings->limits.iDepth && 0 == pSettings->limits.iNodes && 0 == pSettings->limits.iMoveTime )
+   {
+      pSettings->limits.iDepth = 4;
+   }
+
+   return true;
+}
+
+static bool readOpenings(const Settings& settings, std::vector<string>* pOpenings)
+{
+   // One opening per line, moves separated by spaces ("e2e4 e7e5" or "E2-E4 E7-E5")
+   if ( true == settings.openings_file.empty() )
+   {
+      for (unsigned i = 0; i < sizeof(default_openings) / sizeof(default_openings[0]); i++)
+      {
+         pOpenings->push_back(default_openings[i]);
+      }
+
+      return true;
+   }
+
+   std::ifstream ifs(settings.openings_file);
+
+   if ( !ifs )
+   {
+      cerr << "Error loading " << settings.openings_file << "\n";
+      return false;
+   }
+
+   string line;
+
+   while ( getline(ifs, line) )
+   {
+      if ( false == line.empty() && '#' != line[0] )
+      {
+         pOpenings->push_back(line);
+      }
+   }
+
+   return ( false == pOpenings->empty() );
+}
+
+int main(int argc, char* argv[])
+{
+   Settings settings;
+
+   if ( false == readSettings(argc, argv, &settings) )
+   {
+      return 1;
+   }
+
+   std::vector<string> openings;
+
+   if ( false == readOpenings(settings, &openings) )
+   {
+      return 1;
+   }
+
+   cout << "Playing " << settings.iGames << " games, " << settings.iConcurrency << " at a time, "
+        << openings.size() << " openings\n";
+
+   Sprt sprt(settings.dElo0, settings.dElo1, settings.dAlpha, settings.dBeta);
+   std::atomic<int> next_game(0);
+
+   auto    tStart = std::chrono::steady_clock::now();
+   clock_t tCpu   = clock();
+
+   std::vector<std::thread> threads;
+
+   for (int i = 0; i < settings.iConcurrency; i++)
+   {
+      threads.push_back(std::thread(worker, std::cref(settings), std::cref(openings), &next_game, &sprt));
+   }
+
+   for (unsigned i = 0; i < threads.size(); i++)
+   {
+      threads[i].join();
+   }
+
+   double dSeconds    = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - tStart).count() / 1000.0;
+   double dCpuSeconds = double(clock() - tCpu) / CLOCKS_PER_SEC;
+
+#ifndef _WIN32
+   // External engines run in their own processes, which have finished by now
+   struct rusage usage;
+
+   if ( 0 == getrusage(RUSAGE_CHILDREN, &usage) )
+   {
+      dCpuSeconds += usage.ru_utime.tv_sec + usage.ru_utime.tv_usec / 1e6 + usage.ru_stime.tv_sec + usage.ru_stime.tv_usec / 1e6;
+   }
+#endif
+
+   for (int i = 0; i < 2; i++)
+   {
+      string name = settings.commands[i].empty() ? "this build" : settings.commands[i];
+
+      if ( false == settings.options[i].empty() )
+      {
+         name += " (" + settings.options[i] + ")";
+      }
+
+      cout << (0 == i ? "\nA: " : "B: ") << name << "\n";
+   }
+
+   cout << sprt.getSummary() << "\n";
+   cout << std::fixed << std::setprecision(1) << dSeconds << " s, " << (sprt.getGames() / max(dSeconds, 0.001)) << " games/s, "
+        << "CPU time " << dCpuSeconds << " s (" << std::setprecision(2) << dCpuSeconds / max(1, sprt.getGames()) << " s per game)\n";
+
+   if ( false == settings.bSprt )
+   {
+      return 0;
+   }
+
+   switch (sprt.getDecision())
+   {
+      case Sprt::ACCEPT_H1: return 0;
+      case Sprt::ACCEPT_H0: return 2;
+      default:              return 3;
+   }
+}
@@ -0,0 +1,579 @@
+#include "includes.h"
+#include "server.h"
+
+#ifdef __linux__
+
+#include "chess_api.h"
+#include "pool.h"
+
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <errno.h>
+#include <signal.h>
+#include <unistd.h>
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <unordered_map>
+
+
+//---------------------------------------------------------------------------------------
+// Server
+// Usage: chess_console server <socket path> [--workers N]
+//
+// One request per line, one answer per line, in the order of the requests:
+//
+//    N                 New game                 -> OK <game>
+//    M <game> <move>   Move ("e2e4", "e7e8q")   -> OK <status after the move>
+//    L <game>          Legal moves              -> OK e2e4 d2d4 ...
+//    S <game>          Status                   -> OK playing | check | checkmate | stalemate
+//    F <game>          Free the game            -> OK
+//
+// Errors are "ERR <reason>": "ERR game" if there is no such game, "ERR illegal" for a move
+// that is not legal, "ERR move" for one that is not written as a move, "ERR command".
+// A game does not belong to the connection that created it, any client can use it until
+// it is freed.
+//
+// One thread waits on all the sockets with epoll, a pool of workers reads the requests and
+// answers them. A connection is only given to one worker at a time (EPOLLONESHOT, it is
+// armed again when the worker is done), so its answers come in order. A worker takes at
+// most MAX_REQUESTS requests of a connection before it goes back in the queue, so that a
+// client sending without pause does not keep a worker for itself. Answers the client is
+// not reading wait on the connection, the worker never waits for them.
+//
+// Each worker has a SlabPool (pool.h) for the games it creates and their moves: games
+// coming and going by the thousand do not fight over the heap. A game freed by another
+// worker goes back to the pool it came from.
+//---------------------------------------------------------------------------------------
+enum
+{
+   MAX_EVENTS    = 256,
+   MAX_LINE      = 1024, // A client sending a longer line is disconnected
+   READ_SIZE     = 4096,
+   MAX_INPUT     = 16 * READ_SIZE, // Received and not answered yet. No more is read until there is room
+   MAX_REQUESTS  = 256,  // Answered in one turn of a connection
+   MAX_OUTPUT    = 16 * READ_SIZE  // Answers not sent yet. No more requests are answered until the client takes them
+};
+
+struct Session
+{
+   std::mutex  mutex; // A game is used by one request at a time
+   chess_game* pGame;
+
+   Session() : pGame(chess_new()) {}
+   ~Session() { chess_free(pGame); }
+};
+
+struct Connection
+{
+   int    iSocket;
+   string input;      // Received, but not answered yet
+   string output;     // Answered, but not sent yet: the client is not reading them fast enough
+   bool   bEnd;       // Closed by the client. What it sent is still answered
+
+   Connection() : iSocket(-1), bEnd(false) {}
+};
+
+// All the games, by number. Shared pointers, so a game freed by one client is only
+// deleted when the requests still using it are done
+static std::mutex                                             sessions_mutex;
+static std::unordered_map<unsigned, std::shared_ptr<Session>> sessions;
+static unsigned                                               iNextSession = 1;
+
+// Connections with something to read, waiting for a worker
+static std::mutex              queue_mutex;
+static std::condition_variable queue_ready;
+static std::deque<Connection*> ready_connections;
+static bool                    bStopping = false;
+
+static int                   iEpoll     = -1;
+static volatile sig_atomic_t bSignalled = 0;
+
+
+// -------------------------------------------------------------------
+// Requests
+// -------------------------------------------------------------------
+static const char* describeStatus(int iStatus)
+{
+   switch ( iStatus )
+   {
+      case CHESS_CHECK:     return "check";
+      case CHESS_CHECKMATE: return "checkmate";
+      case CHESS_STALEMATE: return "stalemate";
+      default:              return "playing";
+   }
+}
+
+static std::shared_ptr<Session> findSession(unsigned iGame)
+{
+   std::lock_guard<std::mutex> lock(sessions_mutex);
+
+   std::unordered_map<unsigned, std::shared_ptr<Session>>::iterator it = sessions.find(iGame);
+
+   return ( sessions.end() == it ) ? std::shared_ptr<Session>() : it->second;
+}
+
+static string handleRequest(const string& request)
+{
+   std::istringstream iss(request);
+   string             command;
+   unsigned           iGame = 0;
+   string             move;
+
+   iss >> command >> iGame >> move;
+
+   if ( "N" == command )
+   {
+      // The session and its game, from the pool of this worker
+      std::shared_ptr<Session> session = std::allocate_shared<Session>(PoolAllocator<Session>());
+
+      if ( NULL == session->pGame )
+      {
+         return "ERR memory";
+      }
+
+      std::lock_guard<std::mutex> lock(sessions_mutex);
+
+      iGame = iNextSession++;
+      sessions[iGame] = session;
+
+      return "OK " + std::to_string(iGame);
+   }
+
+   if ( "M" != command && "L" != command && "S" != command && "F" != command )
+   {
+      return "ERR command";
+   }
+
+   std::shared_ptr<Session> session = findSession(iGame);
+
+   if ( nullptr == session )
+   {
+      return "ERR game";
+   }
+
+   if ( "F" == command )
+   {
+      std::lock_guard<std::mutex> lock(sessions_mutex);
+      sessions.erase(iGame);
+
+      return "OK";
+   }
+
+   std::lock_guard<std::mutex> lock(session->mutex);
+
+   if ( "M" == command )
+   {
+      int iResult = chess_apply_move(session->pGame, move.c_str());
+
+      if ( CHESS_INVALID_TEXT == iResult )
+      {
+         return "ERR move";
+      }
+
+      if ( CHESS_OK != iResult )
+      {
+         return "ERR illegal";
+      }
+
+      return string("OK ") + describeStatus(chess_status(session->pGame));
+   }
+
+   if ( "L" == command )
+   {
+      chess_move moves[CHESS_MAX_MOVES];
+      int iNumMoves = chess_legal_moves(session->pGame, moves, CHESS_MAX_MOVES);
+
+      string answer = "OK";
+
+      for (int i = 0; i < iNumMoves; i++)
+      {
+         answer += ' ';
+         answer += moves[i].text;
+      }
+
+      return answer;
+   }
+
+   return string("OK ") + describeStatus(chess_status(session->pGame));
+}
+
+
+// -------------------------------------------------------------------
+// Connections
+// -------------------------------------------------------------------
+// As much of the output as the socket takes now. False if the connection is broken
+static bool sendOutput(Connection* pConnection)
+{
+   size_t iSent = 0;
+
+   while ( iSent < pConnection->output.length() )
+   {
+      ssize_t iWritten = send(pConnection->iSocket, pConnection->output.data() + iSent, pConnection->output.length() - iSent, MSG_NOSIGNAL);
+
+      if ( iWritten > 0 )
+      {
+         iSent += iWritten;
+         continue;
+      }
+
+      if ( iWritten < 0 && EINTR == errno )
+      {
+         continue;
+      }
+
+      if ( iWritten < 0 && (EAGAIN == errno || EWOULDBLOCK == errno) )
+      {
+         // The rest when EPOLLOUT says there is room
+         break;
+      }
+
+      return false;
+   }
+
+   pConnection->output.erase(0, iSent);
+
+   return true;
+}
+
+// bMore: requests are left for the next turn. Like output waiting, EPOLLOUT gives it as soon
+// as the client can take answers
+static bool armConnection(Connection* pConnection, int iOperation, bool bMore)
+{
+   struct epoll_event event;
+   memset(&event, 0, sizeof(event));
+
+   event.events   = EPOLLONESHOT;
+   event.data.ptr = pConnection;
+
+   if ( false == pConnection->bEnd && pConnection->input.length() < MAX_INPUT )
+   {
+      event.events |= EPOLLIN | EPOLLRDHUP;
+   }
+
+   if ( true == bMore || false == pConnection->output.empty() )
+   {
+      event.events |= EPOLLOUT;
+   }
+
+   return ( 0 == epoll_ctl(iEpoll, iOperation, pConnection->iSocket, &event) );
+}
+
+static void closeConnection(Connection* pConnection)
+{
+   // Also takes the socket out of the epoll set
+   close(pConnection->iSocket);
+   delete pConnection;
+}
+
+static void serveConnection(Connection* pConnection)
+{
+   // What the client could not take last time, first
+   bool bError = ( false == sendOutput(pConnection) );
+
+   // What there is to read now, up to MAX_INPUT. Nobody else looks at this connection until it is armed again
+   while ( false == bError && false == pConnection->bEnd && pConnection->input.length() < MAX_INPUT )
+   {
+      char achBuffer[READ_SIZE];
+      ssize_t iRead = recv(pConnection->iSocket, achBuffer, sizeof(achBuffer), 0);
+
+      if ( iRead > 0 )
+      {
+         pConnection->input.append(achBuffer, iRead);
+
+         // Only the last line can be incomplete. Checked now, before it takes more memory
+         size_t iLastLine = pConnection->input.rfind('\n');
+         size_t iPartial  = ( string::npos == iLastLine ) ? pConnection->input.length() : pConnection->input.length() - iLastLine - 1;
+
+         if ( iPartial > MAX_LINE )
+         {
+            bError = true;
+            break;
+         }
+
+         continue;
+      }
+
+      if ( iRead < 0 && EINTR == errno )
+      {
+         continue;
+      }
+
+      if ( 0 == iRead )
+      {
+         pConnection->bEnd = true;
+      }
+      else if ( EAGAIN != errno && EWOULDBLOCK != errno )
+      {
+         bError = true;
+      }
+
+      break;
+   }
+
+   size_t iStart    = 0;
+   size_t iEnd;
+   int    iRequests = 0;
+
+   while ( false == bError && iRequests < MAX_REQUESTS && pConnection->output.length() < MAX_OUTPUT &&
+           string::npos != (iEnd = pConnection->input.find('\n', iStart)) )
+   {
+      size_t iLength = iEnd - iStart;
+
+      if ( iLength > 0 && '\r' == pConnection->input[iEnd - 1] )
+      {
+         iLength--;
+      }
+
+      if ( iLength > 0 )
+      {
+         pConnection->output += handleRequest(pConnection->input.substr(iStart, iLength));
+         pConnection->output += '\n';
+         iRequests++;
+      }
+
+      iStart = iEnd + 1;
+   }
+
+   pConnection->input.erase(0, iStart);
+
+   if ( false == bError && false == sendOutput(pConnection) )
+   {
+      bError = true;
+   }
+
+   // The rest of the requests on the next turn, after the other connections waiting
+   bool bMore = ( string::npos != pConnection->input.find('\n') );
+   bool bDone = ( true == pConnection->bEnd && false == bMore && true == pConnection->output.empty() );
+
+   if ( true == bError || true == bDone || false == armConnection(pConnection, EPOLL_CTL_MOD, bMore) )
+   {
+      closeConnection(pConnection);
+   }
+}
+
+static void workerLoop(SlabPool* pPool)
+{
+   PoolScope scope(pPool);
+
+   for (;;)
+   {
+      Connection* pConnection;
+
+      {
+         std::unique_lock<std::mutex> lock(queue_mutex);
+
+         while ( false == bStopping && true == ready_connections.empty() )
+         {
+            queue_ready.wait(lock);
+         }
+
+         if ( true == bStopping )
+         {
+            return;
+         }
+
+         pConnection = ready_connections.front();
+         ready_connections.pop_front();
+      }
+
+      serveConnection(pConnection);
+   }
+}
+
+static void acceptConnections(int iListen)
+{
+   for (;;)
+   {
+      int iSocket = accept4(iListen, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+
+      if ( iSocket < 0 )
+      {
+         // EAGAIN: no more waiting. Anything else (e.g. out of descriptors) is tried again on the next event
+         return;
+      }
+
+      Connection* pConnection = new Connection;
+      pConnection->iSocket = iSocket;
+
+      if ( false == armConnection(pConnection, EPOLL_CTL_ADD, false) )
+      {
+         closeConnection(pConnection);
+      }
+   }
+}
+
+static void onSignal(int)
+{
+   bSignalled = 1;
+}
+
+
+// -------------------------------------------------------------------
+// Main loop
+// -------------------------------------------------------------------
+int runServer(int argc, char* argv[])
+{
+   if ( argc < 2 )
+   {
+      cout << "Usage: chess_console server <socket path> [--workers N]\n";
+      return 1;
+   }
+
+   string path     = argv[1];
+   int    iWorkers = (int) std::thread::hardware_concurrency();
+
+   for (int i = 2; i < argc; i++)
+   {
+      if ( 0 == strcmp(argv[i], "--workers") && i + 1 < argc )
+      {
+         iWorkers = atoi(argv[++i]);
+      }
+   }
+
+   if ( iWorkers < 1 )
+   {
+      iWorkers = 1;
+   }
+
+   struct sockaddr_un address;
+   memset(&address, 0, sizeof(address));
+   address.sun_family = AF_UNIX;
+
+   if ( path.length() >= sizeof(address.sun_path) )
+   {
+      cout << "Socket path too long: " << path << "\n";
+      return 1;
+   }
+
+   strcpy(address.sun_path, path.c_str());
+
+   // A socket left by a server that did not exit cleanly is replaced, any other file is not
+   struct stat status;
+
+   if ( 0 == stat(path.c_str(), &status) && S_ISSOCK(status.st_mode) )
+   {
+      unlink(path.c_str());
+   }
+
+   int iListen = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+
+   if ( iListen < 0 || 0 != bind(iListen, (struct sockaddr*) &address, sizeof(address)) || 0 != listen(iListen, SOMAXCONN) )
+   {
+      cout << "Can't listen on " << path << ": " << strerror(errno) << "\n";
+      return 1;
+   }
+
+   iEpoll = epoll_create1(EPOLL_CLOEXEC);
+
+   struct epoll_event listen_event;
+   memset(&listen_event, 0, sizeof(listen_event));
+
+   listen_event.events   = EPOLLIN;
+   listen_event.data.ptr = NULL; // The connections have their pointer here
+
+   if ( iEpoll < 0 || 0 != epoll_ctl(iEpoll, EPOLL_CTL_ADD, iListen, &listen_event) )
+   {
+      cout << "Can't create the event loop: " << strerror(errno) << "\n";
+      return 1;
+   }
+
+   // Without SA_RESTART, so that epoll_wait() returns
+   struct sigaction action;
+   memset(&action, 0, sizeof(action));
+   action.sa_handler = onSignal;
+
+   sigaction(SIGINT,  &action, NULL);
+   sigaction(SIGTERM, &action, NULL);
+
+   // The pools outlive the workers: the games stay until the end
+   std::unique_ptr<SlabPool[]> pools(new SlabPool[iWorkers]);
+   std::vector<std::thread>    workers;
+
+   for (int i = 0; i < iWorkers; i++)
+   {
+      workers.push_back(std::thread(workerLoop, &pools[i]));
+   }
+
+   cout << "Listening on " << path << " with " << iWorkers << " workers" << endl;
+
+   struct epoll_event events[MAX_EVENTS];
+
+   while ( 0 == bSignalled )
+   {
+      int iNumEvents = epoll_wait(iEpoll, events, MAX_EVENTS, -1);
+
+      if ( iNumEvents < 0 )
+      {
+         if ( EINTR == errno )
+         {
+            continue;
+         }
+
+         cout << "Event loop failed: " << strerror(errno) << "\n";
+         break;
+      }
+
+      for (int i = 0; i < iNumEvents; i++)
+      {
+         if ( NULL == events[i].data.ptr )
+         {
+            acceptConnections(iListen);
+            continue;
+         }
+
+         {
+            std::lock_guard<std::mutex> lock(queue_mutex);
+            ready_connections.push_back((Connection*) events[i].data.ptr);
+         }
+
+         queue_ready.notify_one();
+      }
+   }
+
+   // The requests being answered are finished, the ones still waiting are not
+   {
+      std::lock_guard<std::mutex> lock(queue_mutex);
+      bStopping = true;
+   }
+
+   queue_ready.notify_all();
+
+   for (size_t i = 0; i < workers.size(); i++)
+   {
+      workers[i].join();
+   }
+
+   close(iListen);
+   close(iEpoll);
+   unlink(path.c_str());
+
+   size_t iPoolSize = 0;
+
+   for (int i = 0; i < iWorkers; i++)
+   {
+      iPoolSize += pools[i].getSize();
+   }
+
+   cout << "Server stopped, " << sessions.size() << " games were open, " << iPoolSize / 1024 << " KB in the pools" << endl;
+
+   // Before the pools they came from
+   sessions.clear();
+
+   return 0;
+}
+
+#else
+
+int runServer(int argc, char* argv[])
+{
+   cout << "The server needs Linux (epoll and Unix domain sockets)\n";
+   return 1;
+}
+
+#endif
@@ -0,0 +1,5 @@
+#pragma once
+
+// Serves many games at once to the clients of a Unix domain socket, see server.cpp
+// for the protocol. Linux only. Returns the exit code
+int runServer( int argc, char* argv[] );
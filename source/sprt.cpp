@@ -0,0 +1,185 @@
+#include "includes.h"
+#include "sprt.h"
+
+#include <cmath>
+#include <sstream>
+
+
+// -------------------------------------------------------------------
+// Sprt class
+// -------------------------------------------------------------------
+Sprt::Sprt(double dElo0, double dElo1, double dAlpha, double dBeta)
+{
+   m_dElo0   = dElo0;
+   m_dElo1   = dElo1;
+   m_dAlpha  = dAlpha;
+   m_dBeta   = dBeta;
+
+   m_iWins   = 0;
+   m_iLosses = 0;
+   m_iDraws  = 0;
+}
+
+Sprt::~Sprt()
+{
+}
+
+void Sprt::addResult(double dScore)
+{
+   if ( dScore > 0.75 )
+   {
+      m_iWins++;
+   }
+   else if ( dScore < 0.25 )
+   {
+      m_iLosses++;
+   }
+   else
+   {
+      m_iDraws++;
+   }
+}
+
+int Sprt::getWins(void)
+{
+   return m_iWins;
+}
+
+int Sprt::getLosses(void)
+{
+   return m_iLosses;
+}
+
+int Sprt::getDraws(void)
+{
+   return m_iDraws;
+}
+
+int Sprt::getGames(void)
+{
+   return m_iWins + m_iLosses + m_iDraws;
+}
+
+double Sprt::getScore(void)
+{
+   if ( 0 == getGames() )
+   {
+      return 0.5;
+   }
+
+   return (m_iWins + 0.5 * m_iDraws) / getGames();
+}
+
+double Sprt::getVariance(void)
+{
+   // Variance of the result of one game
+   if ( 0 == getGames() )
+   {
+      return 0.0;
+   }
+
+   double dWin  = double(m_iWins)  / getGames();
+   double dDraw = double(m_iDraws) / getGames();
+   double dScore = getScore();
+
+   return dWin + 0.25 * dDraw - dScore * dScore;
+}
+
+double Sprt::eloToScore(double dElo)
+{
+   return 1.0 / (1.0 + pow(10.0, -dElo / 400.0));
+}
+
+double Sprt::scoreToElo(double dScore)
+{
+   // 100% or 0% would be infinite
+   dScore = max(0.001, min(0.999, dScore));
+
+   return -400.0 * log10(1.0 / dScore - 1.0);
+}
+
+double Sprt::getElo(void)
+{
+   return scoreToElo(getScore());
+}
+
+double Sprt::getEloError(void)
+{
+   if ( 0 == getGames() )
+   {
+      return 0.0;
+   }
+
+   double dDeviation = sqrt(getVariance() / getGames());
+
+   double dHigh = scoreToElo(getScore() + 1.96 * dDeviation);
+   double dLow  = scoreToElo(getScore() - 1.96 * dDeviation);
+
+   return (dHigh - dLow) / 2.0;
+}
+
+double Sprt::getLLR(void)
+{
+   // Normal approximation of the log likelihood ratio (as used by fishtest/cutechess)
+   double dVariance = getVariance();
+
+   if ( 0 == m_iWins + m_iLosses || dVariance <= 0.0 )
+   {
+      return 0.0;
+   }
+
+   double dScore0 = eloToScore(m_dElo0);
+   double dScore1 = eloToScore(m_dElo1);
+
+   return (dScore1 - dScore0) * (2.0 * getScore() - dScore0 - dScore1) / (2.0 * dVariance / getGames());
+}
+
+double Sprt::getLowerBound(void)
+{
+   return log(m_dBeta / (1.0 - m_dAlpha));
+}
+
+double Sprt::getUpperBound(void)
+{
+   return log((1.0 - m_dBeta) / m_dAlpha);
+}
+
+Sprt::Decision Sprt::getDecision(void)
+{
+   double dLLR = getLLR();
+
+   if ( dLLR >= getUpperBound() )
+   {
+      return ACCEPT_H1;
+   }
+
+   if ( dLLR <= getLowerBound() )
+   {
+      return ACCEPT_H0;
+   }
+
+   return CONTINUE;
+}
+
+string Sprt::getSummary(void)
+{
+   // e.g. "Games: 200 W: 60 L: 50 D: 90  Elo: 17.4 +/- 35.2  LLR: 0.45 [-2.94, 2.94] (elo0 0, elo1 5)"
+   std::ostringstream oss;
+
+   oss << std::fixed << std::setprecision(1);
+   oss << "Games: " << getGames() << " W: " << m_iWins << " L: " << m_iLosses << " D: " << m_iDraws;
+   oss << "  Elo: " << getElo() << " +/- " << getEloError();
+   oss << std::setprecision(2);
+   oss << "  LLR: " << getLLR() << " [" << getLowerBound() << ", " << getUpperBound() << "]";
+   oss << std::setprecision(1);
+   oss << " (elo0 " << m_dElo0 << ", elo1 " << m_dElo1 << ")";
+
+   switch (getDecision())
+   {
+      case ACCEPT_H1: oss << "  H1 accepted"; break;
+      case ACCEPT_H0: oss << "  H0 accepted"; break;
+      default: break;
+   }
+
+   return oss.str();
+}
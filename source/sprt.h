@@ -0,0 +1,55 @@
+#pragma once
+#include "includes.h"
+
+// -------------------------------------------------------------------
+// Sequential probability ratio test
+// Decides, with as few games as possible, whether engine A is at least
+// elo1 stronger than engine B (H1) or not more than elo0 stronger (H0)
+// -------------------------------------------------------------------
+class Sprt
+{
+public:
+   Sprt( double dElo0 = 0.0, double dElo1 = 5.0, double dAlpha = 0.05, double dBeta = 0.05 );
+   ~Sprt();
+
+   enum Decision
+   {
+      CONTINUE = 0,
+      ACCEPT_H0,     // No improvement
+      ACCEPT_H1      // Improvement
+   };
+
+   // From A's point of view
+   void addResult( double dScore );
+
+   int getWins( void );
+   int getLosses( void );
+   int getDraws( void );
+   int getGames( void );
+
+   double getElo( void );
+   double getEloError( void );    // 95% confidence
+   double getLLR( void );
+   double getLowerBound( void );
+   double getUpperBound( void );
+
+   Decision getDecision( void );
+
+   string getSummary( void );
+
+private:
+   double m_dElo0;
+   double m_dElo1;
+   double m_dAlpha;
+   double m_dBeta;
+
+   int    m_iWins;
+   int    m_iLosses;
+   int    m_iDraws;
+
+   double getScore( void );
+   double getVariance( void );
+
+   static double eloToScore( double dElo );
+   static double scoreToElo( double dScore );
+};
@@ -0,0 +1,266 @@
+#include "terminal.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <io.h>
+#include <windows.h>
+
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#else
+#include <sys/ioctl.h>
+#include <unistd.h>
+#endif
+
+
+//---------------------------------------------------------------------------------------
+// Terminal
+//---------------------------------------------------------------------------------------
+static const char ESC_CLEAR[]           = "\x1b[H\x1b[2J";
+static const char ESC_ENTER_ALTERNATE[] = "\x1b[?1049h";
+static const char ESC_LEAVE_ALTERNATE[] = "\x1b[?1049l";
+static const char ESC_CLEAR_LINE[]      = "\x1b[K";
+static const char ESC_CLEAR_BELOW[]     = "\x1b[J";
+
+static bool bTerminalReady     = false;
+static bool bIsTerminal        = false;
+static bool bAlternateScreenOn = false;
+
+// Lines the terminal moved down since terminalTakeLineCount() was last called
+static int iLineCount = 0;
+
+// -------------------------------------------------------------------
+// Line counting
+// Whatever goes through cout and cin still goes to the original buffers,
+// only the new lines are counted on the way. The terminal echoes what the
+// user types, so every line read is a line on the screen too
+// -------------------------------------------------------------------
+class CountingOutput : public std::streambuf
+{
+public:
+   CountingOutput( std::streambuf* pTarget ) : m_pTarget(pTarget) {}
+
+protected:
+   int overflow( int iChar )
+   {
+      if ( traits_type::eof() == iChar )
+      {
+         return traits_type::not_eof(iChar);
+      }
+
+      if ( '\n' == iChar )
+      {
+         iLineCount++;
+      }
+
+      return m_pTarget->sputc(traits_type::to_char_type(iChar));
+   }
+
+   std::streamsize xsputn( const char* pData, std::streamsize iSize )
+   {
+      for (std::streamsize i = 0; i < iSize; i++)
+      {
+         if ( '\n' == pData[i] )
+         {
+            iLineCount++;
+         }
+      }
+
+      return m_pTarget->sputn(pData, iSize);
+   }
+
+   int sync( void )
+   {
+      return m_pTarget->pubsync();
+   }
+
+private:
+   std::streambuf* m_pTarget;
+};
+
+class CountingInput : public std::streambuf
+{
+public:
+   CountingInput( std::streambuf* pSource ) : m_pSource(pSource), m_chCurrent(0) {}
+
+protected:
+   int underflow( void )
+   {
+      int iChar = m_pSource->sbumpc();
+
+      if ( traits_type::eof() == iChar )
+      {
+         return iChar;
+      }
+
+      m_chCurrent = traits_type::to_char_type(iChar);
+
+      if ( '\n' == m_chCurrent )
+      {
+         iLineCount++;
+      }
+
+      setg(&m_chCurrent, &m_chCurrent, &m_chCurrent + 1);
+
+      return iChar;
+   }
+
+private:
+   std::streambuf* m_pSource;
+   char            m_chCurrent;
+};
+
+static void writeAll(const char* pData, size_t iSize)
+{
+   while ( iSize > 0 )
+   {
+#ifdef _WIN32
+      int iWritten = _write(1, pData, (unsigned) iSize);
+#else
+      ssize_t iWritten = write(1, pData, iSize);
+#endif
+
+      if ( iWritten <= 0 )
+      {
+         // Nothing else can be done, the output is gone
+         return;
+      }
+
+      pData += iWritten;
+      iSize -= iWritten;
+   }
+}
+
+void terminalInit(bool bAlternateScreen)
+{
+#ifdef _WIN32
+   bIsTerminal = ( 0 != _isatty(1) );
+
+   if ( true == bIsTerminal )
+   {
+      // Escape sequences are only understood by the console after this (Windows 10 and later)
+      HANDLE hOutput = GetStdHandle(STD_OUTPUT_HANDLE);
+      DWORD  dwMode  = 0;
+
+      if ( FALSE == GetConsoleMode(hOutput, &dwMode) ||
+           FALSE == SetConsoleMode(hOutput, dwMode | ENABLE_VIRTUAL_TERMINAL_PROCESSING) )
+      {
+         bIsTerminal = false;
+      }
+   }
+#else
+   bIsTerminal = ( 1 == isatty(1) );
+#endif
+
+   bTerminalReady = true;
+
+   if ( true == bIsTerminal )
+   {
+      // Never deleted, cout can still be used by the destructors of other static objects
+      cout.rdbuf(new CountingOutput(cout.rdbuf()));
+      cin.rdbuf(new CountingInput(cin.rdbuf()));
+   }
+
+   if ( true == bIsTerminal && true == bAlternateScreen )
+   {
+      terminalWrite(ESC_ENTER_ALTERNATE, sizeof(ESC_ENTER_ALTERNATE) - 1);
+      bAlternateScreenOn = true;
+
+      atexit(terminalRestore);
+   }
+}
+
+void terminalRestore(void)
+{
+   if ( true == bAlternateScreenOn )
+   {
+      terminalWrite(ESC_LEAVE_ALTERNATE, sizeof(ESC_LEAVE_ALTERNATE) - 1);
+      bAlternateScreenOn = false;
+   }
+}
+
+bool terminalIsInteractive(void)
+{
+   if ( false == bTerminalReady )
+   {
+      terminalInit(false);
+   }
+
+   return bIsTerminal;
+}
+
+const char* terminalClearSequence(void)
+{
+   return ( true == terminalIsInteractive() ) ? ESC_CLEAR : "";
+}
+
+const char* terminalClearLineSequence(void)
+{
+   return ( true == terminalIsInteractive() ) ? ESC_CLEAR_LINE : "";
+}
+
+const char* terminalClearBelowSequence(void)
+{
+   return ( true == terminalIsInteractive() ) ? ESC_CLEAR_BELOW : "";
+}
+
+string terminalCursorSequence(int iRow, int iColumn)
+{
+   if ( false == terminalIsInteractive() )
+   {
+      return "";
+   }
+
+   char achSequence[32];
+   snprintf(achSequence, sizeof(achSequence), "\x1b[%d;%dH", iRow, iColumn);
+
+   return achSequence;
+}
+
+bool terminalGetSize(int* piRows, int* piColumns)
+{
+   if ( false == terminalIsInteractive() )
+   {
+      return false;
+   }
+
+#ifdef _WIN32
+   CONSOLE_SCREEN_BUFFER_INFO info;
+
+   if ( FALSE == GetConsoleScreenBufferInfo(GetStdHandle(STD_OUTPUT_HANDLE), &info) )
+   {
+      return false;
+   }
+
+   *piRows    = info.srWindow.Bottom - info.srWindow.Top  + 1;
+   *piColumns = info.srWindow.Right  - info.srWindow.Left + 1;
+#else
+   struct winsize size;
+
+   if ( 0 != ioctl(1, TIOCGWINSZ, &size) || 0 == size.ws_row || 0 == size.ws_col )
+   {
+      return false;
+   }
+
+   *piRows    = size.ws_row;
+   *piColumns = size.ws_col;
+#endif
+
+   return true;
+}
+
+int terminalTakeLineCount(void)
+{
+   int iLines = iLineCount;
+   iLineCount = 0;
+
+   return iLines;
+}
+
+void terminalWrite(const char* pData, size_t iSize)
+{
+   cout.flush();
+
+   writeAll(pData, iSize);
+}
@@ -0,0 +1,37 @@
+#pragma once
+#include "includes.h"
+
+//---------------------------------------------------------------------------------------
+// Terminal
+// Screen control with ANSI escape sequences, written straight to the output file
+// descriptor. Nothing happens when the output is not a terminal (a pipe or a file)
+//---------------------------------------------------------------------------------------
+
+// The alternate screen leaves the user's terminal as it was when the program exits
+void terminalInit( bool bAlternateScreen );
+
+void terminalRestore( void );
+
+bool terminalIsInteractive( void );
+
+// Clears the screen and puts the cursor at the top left corner.
+// Empty when the output is not a terminal, so it can always be written
+const char* terminalClearSequence( void );
+
+// For the updates of part of the screen. Rows and columns start at 1
+string terminalCursorSequence( int iRow, int iColumn );
+
+// From the cursor to the end of the line, and to the end of the screen
+const char* terminalClearLineSequence( void );
+
+const char* terminalClearBelowSequence( void );
+
+// Size of the window, false if it is not known (or not a terminal)
+bool terminalGetSize( int* piRows, int* piColumns );
+
+// How many lines the terminal moved down since the last call: the new lines written
+// through cout and the ones typed by the user. terminalWrite() is not counted
+int terminalTakeLineCount( void );
+
+// Whatever cout has buffered goes out first, so the order is kept
+void terminalWrite( const char* pData, size_t iSize );
@@ -0,0 +1,145 @@
+#include "includes.h"
+#include "timeman.h"
+
+
+// -------------------------------------------------------------------
+// TimeManager class
+// -------------------------------------------------------------------
+TimeManager::TimeManager()
+{
+   m_tStart            = std::chrono::steady_clock::now();
+   m_iOptimum          = 0;
+   m_iSoftLimit        = 0;
+   m_iHardLimit        = 0;
+   m_iLastScore        = 0;
+   m_iIterations       = 0;
+   m_iStableIterations = 0;
+}
+
+TimeManager::~TimeManager()
+{
+}
+
+void TimeManager::start(int iTimeLeft, int iIncrement, int iMovesToGo, int iMoveTime)
+{
+   m_tStart            = std::chrono::steady_clock::now();
+   m_iOptimum          = 0;
+   m_iSoftLimit        = 0;
+   m_iHardLimit        = 0;
+   m_iLastScore        = 0;
+   m_iIterations       = 0;
+   m_iStableIterations = 0;
+
+   if ( iMoveTime > 0 )
+   {
+      // Fixed time per move: use all of it, but not a millisecond more
+      m_iOptimum   = max(1, iMoveTime - MOVE_OVERHEAD);
+      m_iSoftLimit = m_iOptimum;
+      m_iHardLimit = m_iOptimum;
+      return;
+   }
+
+   if ( iTimeLeft <= 0 )
+   {
+      // No clock: only depth, nodes or "stop" end the search
+      return;
+   }
+
+   // In sudden death, assume the game goes on for some more moves
+   int iMoves = (iMovesToGo > 0) ? min(iMovesToGo, 50) : 30;
+
+   long long iAvailable = max(1, iTimeLeft - MOVE_OVERHEAD);
+
+   m_iOptimum = iAvailable / iMoves + iIncrement * 3 / 4;
+
+   // Never plan to use more than what is on the clock. The hard limit
+   // leaves room for the moves that still have to be made
+   m_iOptimum   = min(m_iOptimum, iAvailable / 2);
+   m_iHardLimit = min(m_iOptimum * 4, iAvailable / 3 + iIncrement);
+   m_iHardLimit = max(m_iHardLimit, m_iOptimum);
+
+   // The increment only comes after the move: with a low clock and a big increment
+   // (wtime 100 winc 2000) the limits above can still be past the flag. At least a
+   // millisecond, a hard limit of 0 would mean no clock at all
+   m_iOptimum   = max(1LL, min(m_iOptimum,   iAvailable));
+   m_iHardLimit = max(1LL, min(m_iHardLimit, iAvailable));
+
+   // The next iteration usually takes longer than all the previous ones
+   // together, so there is no point in starting it past half of the optimum
+   m_iSoftLimit = max(1LL, m_iOptimum / 2);
+}
+
+void TimeManager::restart(void)
+{
+   m_tStart = std::chrono::steady_clock::now();
+}
+
+void TimeManager::update(int iScore, bool bBestMoveChanged)
+{
+   if ( false == isEnabled() || m_iSoftLimit == m_iHardLimit )
+   {
+      return;
+   }
+
+   m_iIterations++;
+
+   // The first iterations are too shallow to tell anything
+   if ( m_iIterations < 4 )
+   {
+      m_iLastScore = iScore;
+      return;
+   }
+
+   double dFactor = 1.0;
+
+   // Fail low: the score dropped, we might be walking into trouble
+   if ( iScore < m_iLastScore - 30 )
+   {
+      dFactor *= 1.5;
+   }
+
+   // Unstable principal variation: the search has not made up its mind
+   if ( true == bBestMoveChanged )
+   {
+      m_iStableIterations = 0;
+      dFactor *= 1.3;
+   }
+   else if ( ++m_iStableIterations >= 4 )
+   {
+      // Same move over and over, no need to spend the whole budget
+      dFactor *= 0.8;
+   }
+
+   m_iLastScore = iScore;
+   m_iSoftLimit = min((long long)(m_iOptimum / 2 * dFactor), m_iHardLimit);
+}
+
+bool TimeManager::isEnabled(void)
+{
+   return ( m_iHardLimit > 0 );
+}
+
+bool TimeManager::isSoftLimitReached(void)
+{
+   return ( true == isEnabled() && getElapsed() >= m_iSoftLimit );
+}
+
+bool TimeManager::isHardLimitReached(void)
+{
+   return ( true == isEnabled() && getElapsed() >= m_iHardLimit );
+}
+
+long long TimeManager::getElapsed(void)
+{
+   return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - m_tStart).count();
+}
+
+long long TimeManager::getSoftLimit(void)
+{
+   return m_iSoftLimit;
+}
+
+long long TimeManager::getHardLimit(void)
+{
+   return m_iHardLimit;
+}
@@ -0,0 +1,46 @@
+#pragma once
+#include "includes.h"
+
+class TimeManager
+{
+public:
+   TimeManager();
+   ~TimeManager();
+
+   enum
+   {
+      CHECK_INTERVAL = 1024, // Nodes between two looks at the clock
+      MOVE_OVERHEAD  = 30    // Milliseconds lost to the interface, never used for thinking
+   };
+
+   // All times in milliseconds, zero means not given
+   void start( int iTimeLeft, int iIncrement, int iMovesToGo, int iMoveTime );
+
+   // The clock starts again, e.g. after a ponder hit
+   void restart( void );
+
+   // Called after every completed iteration, to give more time when the search is unsure
+   void update( int iScore, bool bBestMoveChanged );
+
+   bool isEnabled( void );
+
+   // Soft: don't start another iteration. Hard: abort the one running
+   bool isSoftLimitReached( void );
+   bool isHardLimitReached( void );
+
+   long long getElapsed( void );
+
+   long long getSoftLimit( void );
+   long long getHardLimit( void );
+
+private:
+   std::chrono::steady_clock::time_point m_tStart;
+
+   long long m_iOptimum;   // What this move should normally take
+   long long m_iSoftLimit;
+   long long m_iHardLimit;
+
+   int       m_iLastScore;
+   int       m_iIterations;
+   int       m_iStableIterations; // Iterations in a row with the same best move
+};
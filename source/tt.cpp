@@ -0,0 +1,87 @@
+#include "includes.h"
+#include "tt.h"
+
+
+// -------------------------------------------------------------------
+// TranspositionTable class
+// -------------------------------------------------------------------
+TranspositionTable::TranspositionTable()
+{
+   m_pEntries   = NULL;
+   m_iMask      = 0;
+   m_iMegabytes = 0;
+}
+
+TranspositionTable::~TranspositionTable()
+{
+   delete[] m_pEntries;
+}
+
+void TranspositionTable::resize(int iMegabytes)
+{
+   // The number of entries must be a power of two, so the index is just a mask of the key
+   unsigned long long iEntries = 1;
+
+   while ( iEntries * 2 * sizeof(Entry) <= (unsigned long long)iMegabytes * 1024 * 1024 )
+   {
+      iEntries *= 2;
+   }
+
+   delete[] m_pEntries;
+
+   m_pEntries   = new Entry[iEntries];
+   m_iMask      = iEntries - 1;
+   m_iMegabytes = iMegabytes;
+
+   clear();
+}
+
+void TranspositionTable::clear(void)
+{
+   if ( NULL != m_pEntries )
+   {
+      memset(m_pEntries, 0, sizeof(Entry) * (m_iMask + 1));
+   }
+}
+
+bool TranspositionTable::probe(unsigned long long iKey, Entry* pEntry)
+{
+   Entry* pSlot = &m_pEntries[iKey & m_iMask];
+
+   if ( pSlot->iKey != iKey || BOUND_NONE == pSlot->iBound )
+   {
+      return false;
+   }
+
+   *pEntry = *pSlot;
+
+   return true;
+}
+
+void TranspositionTable::store(unsigned long long iKey, unsigned short iMove, int iScore, int iDepth, int iBound)
+{
+   Entry* pSlot = &m_pEntries[iKey & m_iMask];
+
+   // For the same position, a shallower search does not replace a deeper one
+   if ( pSlot->iKey == iKey && pSlot->iDepth > iDepth && BOUND_EXACT != iBound )
+   {
+      return;
+   }
+
+   // Keep the move we knew if this search did not find one
+   if ( 0 == iMove && pSlot->iKey == iKey )
+   {
+      iMove = pSlot->iMove;
+   }
+
+   pSlot->iKey   = iKey;
+   pSlot->iMove  = iMove;
+   pSlot->iScore = (short)iScore;
+   pSlot->iDepth = (signed char)iDepth;
+   pSlot->iBound = (unsigned char)iBound;
+}
+
+int TranspositionTable::getSizeInMegabytes(void)
+{
+   return m_iMegabytes;
+}
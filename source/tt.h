@@ -0,0 +1,41 @@
+#pragma once
+#include "includes.h"
+
+class TranspositionTable
+{
+public:
+   TranspositionTable();
+   ~TranspositionTable();
+
+   enum Bound
+   {
+      BOUND_NONE = 0,
+      BOUND_UPPER,   // Score is at most this (no move beat alpha)
+      BOUND_LOWER,   // Score is at least this (cutoff)
+      BOUND_EXACT
+   };
+
+   struct Entry
+   {
+      unsigned long long iKey;
+      unsigned short     iMove;   // Packed move, 0 if none
+      short              iScore;
+      signed char        iDepth;
+      unsigned char      iBound;
+   };
+
+   void resize( int iMegabytes );
+
+   void clear( void );
+
+   bool probe( unsigned long long iKey, Entry* pEntry );
+
+   void store( unsigned long long iKey, unsigned short iMove, int iScore, int iDepth, int iBound );
+
+   int getSizeInMegabytes( void );
+
+private:
+   Entry*             m_pEntries;
+   unsigned long long m_iMask;
+   int                m_iMegabytes;
+};
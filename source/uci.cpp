@@ -0,0 +1,295 @@
+#include "includes.h"
+#include <sstream>
+#include <thread>
+#include <mutex>
+
+#include "uci.h"
+
+
+//---------------------------------------------------------------------------------------
+// UCI
+// Protocol description: http://wbec-ridderkerk.nl/html/UCIProtocol.html
+//---------------------------------------------------------------------------------------
+static Engine*     uci_engine = NULL;
+
+// The search runs on its own thread, so the input loop can still read "stop", "ponderhit" and "quit"
+static std::thread uci_search_thread;
+static std::mutex  uci_output_mutex;
+
+// The position of the search, for "d": the one of the engine changes all the time while it searches
+static string      uci_search_fen;
+
+static void send(const string& line)
+{
+   // Both threads write to stdout, one whole line at a time
+   std::lock_guard<std::mutex> lock(uci_output_mutex);
+   cout << line << endl;
+}
+
+static void sendInfo(const Engine::SearchInfo& info)
+{
+   // e.g. "info depth 6 score cp 35 nodes 123456 nps 987654 time 125 pv e2e4 e7e5"
+   ostringstream oss;
+
+   oss << "info depth " << info.iDepth;
+
+   if ( 0 != info.iMateIn )
+   {
+      oss << " score mate " << info.iMateIn;
+   }
+   else
+   {
+      oss << " score cp " << info.iScore;
+   }
+
+   long long iNps = (info.iTime > 0) ? (info.iNodes * 1000 / info.iTime) : info.iNodes;
+
+   oss << " nodes " << info.iNodes << " nps " << iNps << " time " << info.iTime << " pv";
+
+   for (int i = 0; i < info.iPvLength; i++)
+   {
+      oss << " " << Engine::moveToUci(info.pv[i]);
+   }
+
+   send(oss.str());
+}
+
+static void stopSearch(void)
+{
+   if ( true == uci_search_thread.joinable() )
+   {
+      uci_engine->stop();
+      uci_search_thread.join();
+   }
+}
+
+static void search(Engine::Limits limits)
+{
+   Engine::Move best_move;
+
+   if ( false == uci_engine->think(limits, &best_move) )
+   {
+      // Checkmate or stalemate, there is nothing to play
+      send("bestmove 0000");
+      return;
+   }
+
+   // Statistics of the search, for whoever reads the log
+   Engine::SearchStats stats;
+   uci_engine->getSearchStats(&stats);
+
+   send("info string stats " + Engine::statsToJson(stats));
+
+   string line = "bestmove " + Engine::moveToUci(best_move);
+
+   // The second move of the principal variation is what we expect the opponent to play
+   Engine::Move pv[2];
+
+   if ( 2 == uci_engine->getPrincipalVariation(pv, 2) )
+   {
+      line += " ponder " + Engine::moveToUci(pv[1]);
+   }
+
+   send(line);
+}
+
+static void uciPosition(istringstream& iss)
+{
+   // position [startpos | fen <fen>] [moves <move1> ... <moveN>]
+   string token;
+   string fen;
+
+   iss >> token;
+
+   if ( "startpos" == token )
+   {
+      fen = Engine::START_FEN;
+      iss >> token; // "moves", if any
+   }
+   else if ( "fen" == token )
+   {
+      while ( iss >> token && "moves" != token )
+      {
+         fen += token + " ";
+      }
+   }
+   else
+   {
+      return;
+   }
+
+   if ( false == uci_engine->setFen(fen) )
+   {
+      send("info string Invalid position: " + fen);
+      return;
+   }
+
+   while ( iss >> token )
+   {
+      if ( false == uci_engine->playMove(token) )
+      {
+         send("info string Illegal move: " + token);
+         return;
+      }
+   }
+}
+
+static void uciGo(istringstream& iss)
+{
+   // go [ponder] [wtime x] [btime x] [winc x] [binc x] [movestogo x] [depth x] [nodes x] [movetime x] [infinite]
+   Engine::Limits limits;
+   memset(&limits, 0, sizeof(Engine::Limits));
+
+   string token;
+
+   while ( iss >> token )
+   {
+      if      ( "wtime"     == token ) iss >> limits.iTime[Chess::WHITE_PLAYER];
+      else if ( "btime"     == token ) iss >> limits.iTime[Chess::BLACK_PLAYER];
+      else if ( "winc"      == token ) iss >> limits.iIncrement[Chess::WHITE_PLAYER];
+      else if ( "binc"      == token ) iss >> limits.iIncrement[Chess::BLACK_PLAYER];
+      else if ( "movestogo" == token ) iss >> limits.iMovesToGo;
+      else if ( "depth"     == token ) iss >> limits.iDepth;
+      else if ( "nodes"     == token ) iss >> limits.iNodes;
+      else if ( "movetime"  == token ) iss >> limits.iMoveTime;
+      else if ( "infinite"  == token ) limits.bInfinite = true;
+      else if ( "ponder"    == token ) limits.bPonder = true;
+   }
+
+   uci_search_fen = uci_engine->getFen();
+
+   uci_engine->prepareSearch();
+   uci_search_thread = std::thread(search, limits);
+}
+
+static void uciSetOption(istringstream& iss)
+{
+   // setoption name <id> [value <x>]
+   string token;
+   string name;
+   string value;
+
+   iss >> token; // "name"
+
+   while ( iss >> token && "value" != token )
+   {
+      name += (name.empty() ? "" : " ") + token;
+   }
+
+   while ( iss >> token )
+   {
+      value += (value.empty() ? "" : " ") + token;
+   }
+
+   if ( "Hash" == name )
+   {
+      uci_engine->setHashSize(atoi(value.c_str()));
+   }
+   else if ( "Threads" == name )
+   {
+      // The search is single threaded. Runners that ask for more are told so, rather than
+      // believing they got a parallel search
+      if ( 1 != atoi(value.c_str()) )
+      {
+         send("info string Threads: only 1 is supported, the search is single threaded");
+      }
+   }
+   else if ( "Clear Hash" == name )
+   {
+      uci_engine->clearHash();
+   }
+   else
+   {
+      // Check boxes come as "true" or "false"
+      int iValue = ("true" == value) ? 1 : atoi(value.c_str());
+
+      if ( false == uci_engine->setOption(name, iValue) )
+      {
+         send("info string Unknown option: " + name);
+      }
+   }
+}
+
+void uciLoop(void)
+{
+   uci_engine = new Engine();
+   uci_engine->setFen(Engine::START_FEN);
+   uci_engine->setInfoCallback(sendInfo);
+
+   string line;
+
+   while ( getline(cin, line) )
+   {
+      istringstream iss(line);
+      string command;
+
+      iss >> command;
+
+      if ( "uci" == command )
+      {
+         send("id name Chess console");
+         send("id author Jerome Vonk");
+         send("option name Hash type spin default 16 min 1 max 1024");
+         send("option name Threads type spin default 1 min 1 max 1");
+         send("option name Clear Hash type button");
+         send("option name NullMove type check default true");
+         send("option name LMR type check default true");
+         send("uciok");
+      }
+      else if ( "isready" == command )
+      {
+         // Answered right away, even while searching
+         send("readyok");
+      }
+      else if ( "stop" == command )
+      {
+         // The search thread sends "bestmove" before finishing
+         stopSearch();
+      }
+      else if ( "ponderhit" == command )
+      {
+         uci_engine->ponderhit();
+      }
+      else if ( "quit" == command )
+      {
+         break;
+      }
+      else if ( "ucinewgame" == command )
+      {
+         stopSearch();
+         uci_engine->clearHash();
+         uci_engine->setFen(Engine::START_FEN);
+      }
+      else if ( "position" == command )
+      {
+         stopSearch();
+         uciPosition(iss);
+      }
+      else if ( "go" == command )
+      {
+         stopSearch();
+         uciGo(iss);
+      }
+      else if ( "setoption" == command )
+      {
+         stopSearch();
+         uciSetOption(iss);
+      }
+      else if ( "d" == command )
+      {
+         // Not part of the protocol, but handy when debugging. Answered right away, even
+         // during "go infinite" or "go ponder", without touching the search
+         send( (true == uci_search_thread.joinable()) ? uci_search_fen : uci_engine->getFen() );
+      }
+      else if ( false == command.empty() )
+      {
+         send("info string Unknown command: " + command);
+      }
+   }
+
+   // "quit" (or the end of the input) while thinking
+   stopSearch();
+
+   delete uci_engine;
+   uci_engine = NULL;
+}
@@ -0,0 +1,6 @@
+#pragma once
+#include "engine.h"
+
+// Universal Chess Interface: lets a graphical interface (or a tournament
+// manager) talk to the engine through stdin/stdout
+void uciLoop( void );
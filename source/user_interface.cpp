@@ -1,5 +1,6 @@
 #include "includes.h"
 #include "user_interface.h"
+#include "terminal.h"
 
 // Save the next message to be displayed (regardind last command)
 string next_message;
@@ -18,31 +19,251 @@ void appendToNextMessage( string msg )
 {
    next_message += msg;
 }
+//---------------------------------------------------------------------------------------
+// Frame
+// The screen is composed here and sent with a single write, see presentFrame().
+// When the frame replaces the whole screen (clearScreen() was called) and the previous
+// one is still on the terminal, only the parts of the lines that changed are sent
+//---------------------------------------------------------------------------------------
+enum
+{
+   FRAME_SIZE = 8192, // The whole screen takes less than half of that
+   TAB_SIZE   = 8
+};
+
+static char   frame[FRAME_SIZE];
+static size_t frame_length = 0;
+static bool   frame_clears = false;
+
+// What is on the screen: the last frame that replaced it, line by line
+static std::vector<string> screen_lines;
+static bool                screen_known   = false;
+static int                 screen_rows    = 0;
+static int                 screen_columns = 0;
+
+static void sendFrame(void)
+{
+   // Written after what is already on the screen, which is then no longer known
+   terminalWrite(frame, frame_length);
+   frame_length = 0;
+
+   screen_known = false;
+}
+
+static void frameAppend(const char* pData, size_t iSize)
+{
+   if ( frame_length + iSize > FRAME_SIZE )
+   {
+      // Does not happen with the screens we have, but nothing is lost if it does
+      presentFrame();
+      screen_known = false;
+
+      if ( iSize > FRAME_SIZE )
+      {
+         terminalWrite(pData, iSize);
+         return;
+      }
+   }
+
+   memcpy(frame + frame_length, pData, iSize);
+   frame_length += iSize;
+}
+
+static void frameAppend(const char* pText)
+{
+   frameAppend(pText, strlen(pText));
+}
+
+static void frameAppend(const string& text)
+{
+   frameAppend(text.c_str(), text.length());
+}
+
+static void frameAppend(char chCharacter, size_t iCount = 1)
+{
+   if ( frame_length + iCount > FRAME_SIZE )
+   {
+      presentFrame();
+      screen_known = false;
+   }
+
+   memset(frame + frame_length, chCharacter, iCount);
+   frame_length += iCount;
+}
+
+// Columns taken by the first iLength characters of a line
+static int getWidth(const string& line, size_t iLength)
+{
+   int iWidth = 0;
+
+   for (size_t i = 0; i < iLength; i++)
+   {
+      iWidth = ( '\t' == line[i] ) ? (iWidth / TAB_SIZE + 1) * TAB_SIZE : iWidth + 1;
+   }
+
+   return iWidth;
+}
+
+// The changes needed to turn one line of the screen into another
+static void appendLineUpdate(string* pUpdate, int iRow, const string& old_line, const string& new_line)
+{
+   if ( old_line == new_line )
+   {
+      return;
+   }
+
+   // A tab moves the cursor without erasing what it skips, so those lines are written again entirely
+   if ( string::npos != old_line.find('\t') || string::npos != new_line.find('\t') )
+   {
+      *pUpdate += terminalCursorSequence(iRow, 1);
+      *pUpdate += new_line;
+      *pUpdate += terminalClearLineSequence();
+      return;
+   }
+
+   size_t iFirst = 0;
+
+   while ( iFirst < old_line.length() && iFirst < new_line.length() && old_line[iFirst] == new_line[iFirst] )
+   {
+      iFirst++;
+   }
+
+   *pUpdate += terminalCursorSequence(iRow, (int) iFirst + 1);
+
+   if ( old_line.length() == new_line.length() )
+   {
+      // Same length, from the first to the last character that changed (e.g. the squares of a move)
+      size_t iLast = new_line.length() - 1;
+
+      while ( old_line[iLast] == new_line[iLast] )
+      {
+         iLast--;
+      }
+
+      pUpdate->append(new_line, iFirst, iLast - iFirst + 1);
+   }
+   else
+   {
+      pUpdate->append(new_line, iFirst, string::npos);
+
+      if ( new_line.length() < old_line.length() )
+      {
+         *pUpdate += terminalClearLineSequence();
+      }
+   }
+}
+
+void presentFrame(void)
+{
+   // Counted even if there is nothing to send, they are below the frame already on the screen
+   int iLinesBelow = terminalTakeLineCount();
+
+   bool bClears = frame_clears;
+   frame_clears = false;
+
+   if ( 0 == frame_length )
+   {
+      return;
+   }
+
+   if ( false == bClears || false == terminalIsInteractive() )
+   {
+      sendFrame();
+      return;
+   }
+
+   std::vector<string> lines;
+   size_t iStart = 0;
+
+   for (size_t i = 0; i <= frame_length; i++)
+   {
+      if ( i == frame_length || '\n' == frame[i] )
+      {
+         lines.push_back(string(frame + iStart, i - iStart));
+         iStart = i + 1;
+      }
+   }
+
+   // Cursor addressing only works if nothing scrolled, and nothing will: every line
+   // fits in the window and there is room below for what the user types
+   int  iRows    = 0;
+   int  iColumns = 0;
+   bool bFits    = terminalGetSize(&iRows, &iColumns) && (int) lines.size() < iRows;
+
+   for (size_t i = 0; i < lines.size() && true == bFits; i++)
+   {
+      bFits = getWidth(lines[i], lines[i].length()) < iColumns;
+   }
+
+   string update;
+
+   if ( true  == screen_known && true == bFits && iRows == screen_rows && iColumns == screen_columns &&
+        (int) screen_lines.size() + iLinesBelow < iRows )
+   {
+      for (size_t i = 0; i < lines.size(); i++)
+      {
+         appendLineUpdate(&update, (int) i + 1, ( i < screen_lines.size() ) ? screen_lines[i] : "", lines[i]);
+      }
+
+      // The cursor goes back to the end of the frame, and the rest of the old screen
+      // (the user's input and whatever was written after it) is erased
+      update += terminalCursorSequence((int) lines.size(), getWidth(lines.back(), lines.back().length()) + 1);
+      update += terminalClearBelowSequence();
+   }
+   else
+   {
+      update  = terminalClearSequence();
+      update.append(frame, frame_length);
+   }
+
+   terminalWrite(update.c_str(), update.length());
+   frame_length = 0;
+
+   screen_lines.swap(lines);
+   screen_known   = bFits;
+   screen_rows    = iRows;
+   screen_columns = iColumns;
+}
+
+void printPrompt(string prompt)
+{
+   // The prompt is the last part of the frame, what comes next is the user's input
+   frameAppend(prompt);
+   presentFrame();
+}
+
 void clearScreen(void)
 {
-   system("cls");
+   // No shell is started for this, see terminal.cpp. Whatever was composed before would
+   // be erased anyway, and the screen is only cleared when the new frame is ready
+   if ( true == terminalIsInteractive() )
+   {
+      frame_length = 0;
+      frame_clears = true;
+   }
 }
 
 void printLogo(void)
 {
-   cout << "    ======================================\n";
-   cout << "       _____ _    _ ______  _____ _____\n";
-   cout << "      / ____| |  | |  ____|/ ____/ ____|\n";
-   cout << "     | |    | |__| | |__  | (___| (___ \n";
-   cout << "     | |    |  __  |  __|  \\___ \\\\___ \\ \n";
-   cout << "     | |____| |  | | |____ ____) |___) |\n";
-   cout << "      \\_____|_|  |_|______|_____/_____/\n\n";
-   cout << "    ======================================\n\n";
+   frameAppend("    ======================================\n"
+               "       _____ _    _ ______  _____ _____\n"
+               "      / ____| |  | |  ____|/ ____/ ____|\n"
+               "     | |    | |__| | |__  | (___| (___ \n"
+               "     | |    |  __  |  __|  \\___ \\\\___ \\ \n"
+               "     | |____| |  | | |____ ____) |___) |\n"
+               "      \\_____|_|  |_|______|_____/_____/\n\n"
+               "    ======================================\n\n");
 }
 
 void printMenu(void)
 {
-   cout << "Commands: (N)ew game\t(M)ove \t(U)ndo \t(S)ave \t(L)oad \t(Q)uit \n";
+   frameAppend("Commands: (N)ew game\t(M)ove \t(C)omputer \t(U)ndo \t(S)ave \t(L)oad \t(Q)uit \n");
 }
 
 void printMessage(void)
 {
-   cout << next_message << endl;
+   frameAppend(next_message);
+   frameAppend('\n');
 
    next_message = "";
 }
@@ -60,117 +281,108 @@ void printLine(int iLine, int iColor1, int iColor2, Game& game)
    // It represents how many horizontal characters will form one square
    // The number of vertical characters will be CELL/2
    // You can change it to alter the size of the board (an odd number will make the squares look rectangular)
-   int CELL = 6;
+   const int CELL = 6;
+
+   // The pieces of this line, read only once
+   char achPieces[8];
+
+   for (int iColumn = 0; iColumn < 8; iColumn++)
+   {
+      achPieces[iColumn] = game.getPieceAtPosition(iLine, iColumn);
+   }
 
    // Since the width of the characters BLACK and WHITE is half of the height,
    // we need to use two characters in a row.
    // So if we have CELL characters, we must have CELL/2 sublines
    for (int subLine = 0; subLine < CELL/2; subLine++)
    {
-      // A sub-line is consisted of 8 cells, but we can group it
-      // in 4 iPairs of black&white
-      for (int iPair = 0; iPair < 4; iPair++)
+      // A sub-line is consisted of 8 cells, alternating the two colors
+      for (int iColumn = 0; iColumn < 8; iColumn++)
       {
-         // First cell of the pair
-         for (int subColumn = 0; subColumn < CELL; subColumn++)
+         char chColor = char( (0 == iColumn % 2) ? iColor1 : iColor2 );
+
+         // The piece should be in the "middle" of the cell
+         // For 3 sub-lines, in sub-line 1
+         // For 6 sub-columns, sub-column 3
+         if ( 1 == subLine && EMPTY_SQUARE != achPieces[iColumn] )
          {
-            // The piece should be in the "middle" of the cell
-            // For 3 sub-lines, in sub-line 1
-            // For 6 sub-columns, sub-column 3
-            if ( subLine == 1 && subColumn == 3)
-            {
-               cout << char(game.getPieceAtPosition(iLine, iPair*2) != 0x20 ? game.getPieceAtPosition(iLine, iPair*2) : iColor1);
-            }
-            else
-            {
-               cout << char(iColor1);
-            }
+            frameAppend(chColor, CELL/2);
+            frameAppend(achPieces[iColumn]);
+            frameAppend(chColor, CELL - CELL/2 - 1);
          }
-
-         // Second cell of the pair
-         for (int subColumn = 0; subColumn < CELL; subColumn++)
+         else
          {
-            // The piece should be in the "middle" of the cell
-            // For 3 sub-lines, in sub-line 1
-            // For 6 sub-columns, sub-column 3
-            if ( subLine == 1 && subColumn == 3)
-            {
-               cout << char(game.getPieceAtPosition(iLine,iPair*2+1) != 0x20 ? game.getPieceAtPosition(iLine,iPair*2+1) : iColor2);
-            }
-            else
-            {
-               cout << char(iColor2);
-            }
+            frameAppend(chColor, CELL);
          }
       }
 
       // Write the number of the line on the right
       if ( 1 == subLine )
       {
-         cout << "   " << iLine+1;
+         frameAppend("   ");
+         frameAppend(char('1' + iLine));
       }
 
-      cout << "\n";
-
+      frameAppend('\n');
    }
 }
 
 void printSituation(Game& game)
 {
    // Last moves - print only if at least one move has been made
-   if ( 0 != game.rounds.size() )
+   if ( 0 != game.getNumRounds() )
    {
-      cout << "Last moves:\n";
+      frameAppend("Last moves:\n");
 
-      int iMoves = game.rounds.size();
+      int iMoves = game.getNumRounds();
       int iToShow = iMoves >= 5 ? 5 : iMoves;
 
-      string space = "";
-
       while( iToShow-- )
       {
-         if ( iMoves < 10 )
-         {
-            // Add an extra hardspace to allign the numbers that are smaller than 10
-            space = " ";
-         }
+         // Add an extra hardspace to allign the numbers that are smaller than 10
+         char achNumber[16];
+         snprintf(achNumber, sizeof(achNumber), (iMoves < 10) ? " %d ..... " : "%d ..... ", iMoves);
 
-         cout << space << iMoves << " ..... " <<  game.rounds[iMoves-1].white_move.c_str() << " | " << game.rounds[iMoves - 1].black_move.c_str() << "\n";
+         frameAppend(achNumber);
+         frameAppend(game.getRoundText(iMoves - 1));
+         frameAppend('\n');
          iMoves--;
       }
 
-      cout << "\n";
+      frameAppend('\n');
    }
 
    // Captured pieces - print only if at least one piece has been captured
-   if ( 0 != game.white_captured.size() || 0 != game.black_captured.size() )
+   if ( 0 != game.getNumCaptured(Chess::WHITE_PIECE) || 0 != game.getNumCaptured(Chess::BLACK_PIECE) )
    {
-      cout << "---------------------------------------------\n";
-      cout << "WHITE captured: ";
-      for (unsigned i = 0; i < game.white_captured.size(); i++)
+      frameAppend("---------------------------------------------\n");
+      frameAppend("WHITE captured: ");
+      for (int i = 0; i < game.getNumCaptured(Chess::WHITE_PIECE); i++)
       {
-         cout << char(game.white_captured[i]) << " ";
+         frameAppend(game.getCaptured(Chess::WHITE_PIECE, i));
+         frameAppend(' ');
       }
-      cout << "\n";
+      frameAppend('\n');
 
-      cout << "black captured: ";
-      for (unsigned i = 0; i < game.black_captured.size(); i++)
+      frameAppend("black captured: ");
+      for (int i = 0; i < game.getNumCaptured(Chess::BLACK_PIECE); i++)
       {
-         cout << char(game.black_captured[i]) << " ";
+         frameAppend(game.getCaptured(Chess::BLACK_PIECE, i));
+         frameAppend(' ');
       }
-      cout << "\n";
+      frameAppend('\n');
 
-      cout << "---------------------------------------------\n";
+      frameAppend("---------------------------------------------\n");
    }
 
    // Current turn
-   cout << "Current turn: " << (game.getCurrentTurn() == Chess::WHITE_PIECE ? "WHITE (upper case)" : "BLACK (lower case)") << "\n\n";
-
+   frameAppend("Current turn: ");
+   frameAppend(game.getCurrentTurn() == Chess::WHITE_PIECE ? "WHITE (upper case)\n\n" : "BLACK (lower case)\n\n");
 }
 
 void printBoard(Game& game)
 {
-   cout << "   A     B     C     D     E     F     G     H\n\n";
+   frameAppend("   A     B     C     D     E     F     G     H\n\n");
 
    for (int iLine = 7; iLine >= 0; iLine--)
    {
@@ -3,7 +3,6 @@
 
 #define WHITE_SQUARE 0xDB
 #define BLACK_SQUARE 0xFF
-#define EMPTY_SQUARE 0x20
 
 void createNextMessage( string msg );
 void appendToNextMessage( string msg );
@@ -14,4 +13,10 @@ void printMenu( void );
 void printMessage( void );
 void printLine( int iLine, int iColor1, int iColor2, Game& game );
 void printSituation( Game& game );
-void printBoard(Game& game);
\ No newline at end of file
+void printBoard(Game& game);
+
+// The functions above compose the screen in memory, it is only sent to the output here
+void presentFrame( void );
+
+// Adds the prompt and sends the frame, right before reading the user's input
+void printPrompt( string prompt );
\ No newline at end of file